@@ -0,0 +1,83 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "JsonReader.h"
+#include <iostream>
+#include <fstream>
+
+using namespace std;
+
+struct point {
+	int64_t x;
+	double y;
+};
+
+int main(int argc, char **argv) {
+
+	if (argc != 2) {
+		cerr
+				<< "This program pulls the output of example3 straight into structs using a JsonReader"
+				<< endl << "	USAGE: " << argv[0] << " filename" << endl;
+		return 1;
+	}
+	{
+		ifstream in(argv[1]);
+
+		if (!in) {
+			cout << "Cannot open input file " << argv[1] << endl;
+			return 1;
+		}
+
+		// no JsonHandle tree is built, unknown members are skipped
+		JsonReader reader(in);
+		while (reader.next() == JsonReader::OBJECT) {
+			point pt = { 0, 0 };
+			reader.enterObject();
+			while (reader.next() != JsonReader::END_OBJECT) {
+				if (reader.type() == JsonReader::INVALID)
+					break;
+				if (reader.key() == "x")
+					pt.x = reader.getInt64();
+				else if (reader.key() == "y")
+					pt.y = (double) reader.getDouble();
+				else
+					reader.skipValue();
+			}
+			if (reader.type() == JsonReader::INVALID)
+				break;
+			cout << " x:" << pt.x << ", y:" << pt.y << endl;
+		}
+		if (reader.type() == JsonReader::INVALID) {
+			cerr << "Invalid: " << reader.error() << " at byte "
+					<< reader.offset() << endl;
+			return 1;
+		}
+
+		in.close();
+	}
+
+	cout << "read file " << argv[1] << endl;
+	return 0;
+}
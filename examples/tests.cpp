@@ -0,0 +1,250 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Regression checks, run by "make check".  Prints each failure and exits
+ * non-zero when there was one.
+ */
+
+#include "JsonHandle.h"
+#include "JsonBind.h"
+#include "JsonPublished.h"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			cerr << __FILE__ << ":" << __LINE__ << ": failed: " #cond << endl; \
+			failures++; \
+		} \
+	} while (0)
+
+static string compact(const JsonHandle &h) {
+	string s;
+	h.toCompactString(s);
+	return s;
+}
+
+// copies of objects must keep every member's value, whatever its type
+static void testCopyObject() {
+	const char *text =
+			"{\"id\":7,\"name\":\"x\",\"r\":[1,2.5,{\"k\":true}],\"n\":null}";
+	JsonHandle from;
+	from.fromString(text);
+
+	JsonHandle to;
+	to.copy(from);
+	CHECK(compact(to) == text);
+
+	JsonHandle assigned;
+	assigned = from;
+	CHECK(compact(assigned) == text);
+
+	// into an object that already has members
+	JsonHandle existing;
+	existing.fromString("{\"old\":\"gone\"}");
+	existing.copy(from);
+	CHECK(compact(existing) == text);
+}
+
+// views read packed members in place and agree with unpacked arrays
+static void testPackedReads() {
+	const char *text = "{\"i\":[1,-2,3],\"d\":[0.5,-1.25]}";
+	JsonParseOptions saved = JsonHandle::defaultParseOptions;
+	JsonHandle plain;
+	plain.fromString(text);
+	JsonHandle::defaultParseOptions.packArrays = true;
+	JsonHandle packed;
+	packed.fromString(text);
+	JsonHandle::defaultParseOptions = saved;
+
+	JsonView a = plain, b = packed;
+	CHECK(sizeof(JsonView) == sizeof(void *));
+	CHECK(b["i"].size() == 3 && b["d"].size() == 2);
+	CHECK(b["i"][1].isNumber() && !b["i"][1].isArray());
+	CHECK(!b["i"][3].isDefined());
+	for (int k = 0; k < 3; k++)
+		CHECK(a["i"][k].longValue() == b["i"][k].longValue());
+	long double sum = 0;
+	for (JsonView::iterator i = b["d"].begin(); i != b["d"].end(); ++i)
+		sum += (*i).doubleValue();
+	CHECK(sum == -0.75);
+	CHECK(compact(plain) == compact(packed));
+
+	// a handle to a member makes the nodes and can change it
+	packed["i"][0] = 10;
+	CHECK(compact(packed) == "{\"i\":[10,-2,3],\"d\":[0.5,-1.25]}");
+}
+
+// both validate() overloads honour defaultParseOptions
+static void testValidateOptions() {
+	const char *text = "[[1],[2]]";
+	size_t length = strlen(text);
+	JsonError error;
+	CHECK(JsonHandle::validate(text, length));
+	JsonHandle::defaultParseOptions.maxDepth = 1;
+	CHECK(!JsonHandle::validate(text, length));
+	CHECK(!JsonHandle::validate(text, length, error));
+	string out;
+	CHECK(!JsonHandle::minify(text, length, out));
+	CHECK(!JsonHandle::prettify(text, length, out));
+	JsonHandle::defaultParseOptions = JsonParseOptions();
+
+	// with lazyNumbers the number text is kept, as in a tree
+	JsonHandle::defaultParseOptions.lazyNumbers = true;
+	text = "[1.50,1e2,-0]";
+	JsonHandle root;
+	root.fromString(text);
+	out.clear();
+	CHECK(JsonHandle::minify(text, strlen(text), out));
+	CHECK(out == compact(root) && out == text);
+	JsonHandle::defaultParseOptions = JsonParseOptions();
+}
+
+// validate() and minify() reject input fromString() tolerates, strict
+// reads from a stream reject it too
+static void testValidateStrict() {
+	const char *bad[] = { "[1,]", "{\"a\":1,}", "01", "-01", "1.", "[2.e3]",
+			"\"\\x\"", "\"a\tb\"", "{\"a\\q\":1}", 0 };
+	JsonParseOptions strict;
+	strict.strict = true;
+	for (int i = 0; bad[i]; i++) {
+		string out;
+		CHECK(!JsonHandle::validate(bad[i], strlen(bad[i])));
+		CHECK(!JsonHandle::minify(bad[i], strlen(bad[i]), out));
+		std::istringstream in(bad[i]);
+		JsonReader reader(in);
+		reader.setOptions(strict);
+		JsonHandle root;
+		CHECK(root.fromReader(reader) == JsonHandle::JSON_ERROR);
+	}
+	const char *good = "[0,-0,0.5,10,1e5,\"\\u00e9\\n\\/\",{\"a\":[]}]";
+	CHECK(JsonHandle::validate(good, strlen(good)));
+	JsonHandle root;
+	CHECK(!(root.fromString("[1,2,]") == JsonHandle::JSON_ERROR));
+}
+
+// strings over maxStringLength fail before they are copied, escapes too
+static void testStringLimit() {
+	const char *texts[] = { "\"abcdefgh\"", "\"abc\\u00e9\"",
+			"\"\\uD800\\uD800\\uD800\"", "\"abc\\q\"", 0 };
+	JsonParseOptions options;
+	options.maxStringLength = 4;
+	for (int i = 0; texts[i]; i++)
+		for (int stream = 0; stream < 2; stream++) {
+			std::istringstream in(texts[i]);
+			JsonReader reader(texts[i], strlen(texts[i]));
+			if (stream)
+				reader.reset(in);
+			reader.setOptions(options);
+			reader.next();
+			string to;
+			CHECK(!reader.getString(to) && to.length() <= 4);
+			CHECK(reader.errorCode() == JsonError::STRING_TOO_LONG);
+		}
+	const char *fits = "\"ab\\u00e9\"";
+	JsonReader reader(fits, strlen(fits));
+	reader.setOptions(options);
+	reader.next();
+	CHECK(reader.getString() == "ab\xc3\xa9");
+}
+
+#ifdef JSON_HAS_CXX11
+// a moved-to snapshot gives up its version and keeps the one it was given
+static void testSnapshotMove() {
+	JsonPublished config;
+	JsonHandle first, second;
+	first["v"] = 1;
+	second["v"] = 2;
+	config.publish(first);
+	JsonPublished::snapshot a = config.read();
+	config.publish(second);
+	JsonPublished::snapshot b = config.read();
+	a = std::move(b);
+	CHECK(a.root()["v"].longValue() == 2);
+	CHECK(!b.root().isDefined());
+	a = std::move(a);
+	CHECK(a.root()["v"].longValue() == 2);
+	b = config.read();
+	CHECK(b.root()["v"].longValue() == 2);
+}
+#endif
+
+#ifdef JSON_HAS_CXX17
+struct BindTarget {
+	std::optional<int> count;
+	std::optional<std::string> label;
+	std::vector<int> values;
+};
+
+template<> struct JsonFields<BindTarget> {
+	static constexpr auto fields = std::make_tuple(
+			JsonField("count", &BindTarget::count),
+			JsonField("label", &BindTarget::label),
+			JsonField("values", &BindTarget::values));
+};
+
+// values of the wrong type leave optionals alone and are left out of vectors
+static void testBindWrongTypes() {
+	BindTarget t;
+	t.label = "kept";
+	JsonError error;
+	CHECK(JsonBind::fromString(
+			"{\"count\":\"str\",\"label\":7,\"values\":[1,\"a\",2,null,{},3]}",
+			t, error));
+	CHECK(!t.count.has_value());
+	CHECK(t.label == std::optional<std::string>("kept"));
+	CHECK(t.values == std::vector<int>({ 1, 2, 3 }));
+
+	CHECK(JsonBind::fromString("{\"count\":4,\"label\":null}", t, error));
+	CHECK(t.count == std::optional<int>(4));
+	CHECK(!t.label.has_value());
+}
+#endif
+
+int main() {
+	testCopyObject();
+	testPackedReads();
+	testValidateOptions();
+	testValidateStrict();
+	testStringLimit();
+#ifdef JSON_HAS_CXX11
+	testSnapshotMove();
+#endif
+#ifdef JSON_HAS_CXX17
+	testBindWrongTypes();
+#endif
+	if (failures)
+		cerr << failures << " failed" << endl;
+	else
+		cout << "all passed" << endl;
+	return failures ? 1 : 0;
+}
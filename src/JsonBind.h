@@ -0,0 +1,496 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef __JSONBIND_H__
+#define __JSONBIND_H__
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include "JsonKey.h"
+#include "JsonReader.h"
+#include "JsonHandle.h"
+
+/**
+ * class: JsonBindSupport
+ *
+ * The formatting used by JsonHandle, for the encoders in JsonBind.
+ */
+class JsonBindSupport {
+public:
+	static void appendLong(std::string &buffer, int64_t value);
+
+	static void appendULong(std::string &buffer, uint64_t value);
+
+	static void appendDouble(std::string &buffer, long double value,
+			int precision);
+
+	static void appendString(std::string &buffer, const char *value,
+			size_t length);
+};
+
+#ifdef JSON_HAS_CXX17
+
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * struct: JsonField
+ *
+ * One member of a struct and the key it is stored under, see JsonFields.
+ */
+template<class S, class T>
+struct JsonField {
+	JsonKey key;
+	T S::*member;
+
+	constexpr JsonField(const JsonKey &key, T S::*member) :
+			key(key), member(member) {
+	}
+};
+
+/**
+ * struct: JsonFields
+ *
+ * Describes the members of a struct for JsonBind.  Specialize it with a
+ * tuple of JsonField, the keys are hashed at compile time:
+ *
+ *    template<> struct JsonFields<Point> {
+ *       static constexpr auto fields = std::make_tuple(
+ *             JsonField("x", &Point::x),
+ *             JsonField("y", &Point::y));
+ *    };
+ */
+template<class T>
+struct JsonFields;
+
+/**
+ * struct: JsonCodec
+ *
+ * Reads and writes one C++ type.  read() is called with the reader on a
+ * value and consumes it.  A value of the wrong type is skipped and
+ * leaves the target unchanged; read() only fails on a syntax error.
+ * accepts() tells the types of value read() takes, so optionals and
+ * vectors skip the others without making an item.  Specialize it to bind
+ * other types; a codec without accepts() is given every value.
+ */
+template<class T, class Enable = void>
+struct JsonCodec;
+
+/*
+ * JsonCodecAccepts<C>::test(type) calls C::accepts(type), or is true for
+ * codecs that do not have one.
+ */
+template<class C, class Enable = void>
+struct JsonCodecAccepts {
+	static bool test(JsonReader::Type) {
+		return true;
+	}
+};
+
+template<class C>
+struct JsonCodecAccepts<C,
+		std::void_t<decltype(C::accepts(JsonReader::NULLVALUE))>> {
+	static bool test(JsonReader::Type type) {
+		return C::accepts(type);
+	}
+};
+
+template<>
+struct JsonCodec<bool> {
+	static bool accepts(JsonReader::Type type) {
+		return type == JsonReader::BOOLEAN;
+	}
+
+	static bool read(JsonReader &reader, bool &value) {
+		if (reader.type() == JsonReader::BOOLEAN)
+			value = reader.getBoolean();
+		return reader.skipValue();
+	}
+
+	static void write(std::string &buffer, bool value, int) {
+		buffer.append(value ? "true" : "false");
+	}
+};
+
+template<class T>
+struct JsonCodec<T,
+		std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>>> {
+	static bool accepts(JsonReader::Type type) {
+		return type == JsonReader::NUMBER;
+	}
+
+	static bool read(JsonReader &reader, T &value) {
+		if (reader.type() == JsonReader::NUMBER) {
+			int64_t v = reader.getInt64();
+			if (v < (int64_t) std::numeric_limits<T>::min())
+				v = std::numeric_limits<T>::min();
+			else if (v > (int64_t) std::numeric_limits<T>::max())
+				v = std::numeric_limits<T>::max();
+			value = (T) v;
+		}
+		return reader.skipValue();
+	}
+
+	static void write(std::string &buffer, T value, int) {
+		JsonBindSupport::appendLong(buffer, value);
+	}
+};
+
+template<class T>
+struct JsonCodec<T,
+		std::enable_if_t<std::is_integral_v<T> && std::is_unsigned_v<T>
+				&& !std::is_same_v<T, bool>>> {
+	static bool accepts(JsonReader::Type type) {
+		return type == JsonReader::NUMBER;
+	}
+
+	static bool read(JsonReader &reader, T &value) {
+		if (reader.type() == JsonReader::NUMBER) {
+			uint64_t v = reader.getUInt64();
+			if (v > (uint64_t) std::numeric_limits<T>::max())
+				v = std::numeric_limits<T>::max();
+			value = (T) v;
+		}
+		return reader.skipValue();
+	}
+
+	static void write(std::string &buffer, T value, int) {
+		JsonBindSupport::appendULong(buffer, value);
+	}
+};
+
+template<class T>
+struct JsonCodec<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+	static bool accepts(JsonReader::Type type) {
+		return type == JsonReader::NUMBER;
+	}
+
+	static bool read(JsonReader &reader, T &value) {
+		if (reader.type() == JsonReader::NUMBER)
+			value = (T) reader.getDouble();
+		return reader.skipValue();
+	}
+
+	static void write(std::string &buffer, T value, int precision) {
+		JsonBindSupport::appendDouble(buffer, value, precision);
+	}
+};
+
+template<>
+struct JsonCodec<std::string> {
+	static bool accepts(JsonReader::Type type) {
+		return type == JsonReader::STRING;
+	}
+
+	static bool read(JsonReader &reader, std::string &value) {
+		if (reader.type() == JsonReader::STRING)
+			reader.getString(value);
+		return reader.skipValue();
+	}
+
+	static void write(std::string &buffer, const std::string &value, int) {
+		JsonBindSupport::appendString(buffer, value.data(), value.length());
+	}
+};
+
+// an undefined handle is written as null, or left out of a struct
+template<>
+struct JsonCodec<JsonHandle> {
+	static bool read(JsonReader &reader, JsonHandle &value) {
+		value.clear();
+		value.fromReader(reader);
+		return reader.errorCode() == JsonError::NONE;
+	}
+
+	static void write(std::string &buffer, const JsonHandle &value,
+			int precision) {
+		if (value.isDefined())
+			value.toCompactString(buffer, precision);
+		else
+			buffer.append("null");
+	}
+
+	static bool present(const JsonHandle &value) {
+		return value.isDefined();
+	}
+};
+
+// null resets the optional, an empty one is left out of a struct
+template<class T>
+struct JsonCodec<std::optional<T>> {
+	static bool accepts(JsonReader::Type type) {
+		return type == JsonReader::NULLVALUE
+				|| JsonCodecAccepts<JsonCodec<T>>::test(type);
+	}
+
+	static bool read(JsonReader &reader, std::optional<T> &value) {
+		if (reader.type() == JsonReader::NULLVALUE) {
+			value.reset();
+			return reader.skipValue();
+		}
+		if (!JsonCodecAccepts<JsonCodec<T>>::test(reader.type()))
+			return reader.skipValue();
+		if (!value)
+			value.emplace();
+		return JsonCodec<T>::read(reader, *value);
+	}
+
+	static void write(std::string &buffer, const std::optional<T> &value,
+			int precision) {
+		if (value)
+			JsonCodec<T>::write(buffer, *value, precision);
+		else
+			buffer.append("null");
+	}
+
+	static bool present(const std::optional<T> &value) {
+		return value.has_value();
+	}
+};
+
+template<class T, class A>
+struct JsonCodec<std::vector<T, A>> {
+	static bool accepts(JsonReader::Type type) {
+		return type == JsonReader::ARRAY;
+	}
+
+	// items of the wrong type are skipped, not added as T()
+	static bool read(JsonReader &reader, std::vector<T, A> &value) {
+		if (reader.type() != JsonReader::ARRAY)
+			return reader.skipValue();
+		if (!reader.enterArray())
+			return false;
+		value.clear();
+		while (1) {
+			JsonReader::Type t = reader.next();
+			if (t == JsonReader::END_ARRAY)
+				return true;
+			if (t < JsonReader::NULLVALUE || t > JsonReader::ARRAY)
+				return false;
+			if (!JsonCodecAccepts<JsonCodec<T>>::test(t)) {
+				if (!reader.skipValue())
+					return false;
+				continue;
+			}
+			T item = T();
+			if (!JsonCodec<T>::read(reader, item))
+				return false;
+			value.push_back(std::move(item));
+		}
+	}
+
+	static void write(std::string &buffer, const std::vector<T, A> &value,
+			int precision) {
+		buffer.push_back('[');
+		for (size_t i = 0; i < value.size(); i++) {
+			if (i > 0)
+				buffer.push_back(',');
+			JsonCodec<T>::write(buffer, value[i], precision);
+		}
+		buffer.push_back(']');
+	}
+};
+
+/*
+ * A struct described by JsonFields.  Members are found with a
+ * JsonKeySet in one pass and members that are not described are
+ * skipped without being decoded.
+ */
+template<class T>
+struct JsonCodec<T, std::void_t<decltype(JsonFields<T>::fields)>> {
+	static bool accepts(JsonReader::Type type) {
+		return type == JsonReader::OBJECT;
+	}
+
+	static bool read(JsonReader &reader, T &value) {
+		if (reader.type() != JsonReader::OBJECT)
+			return reader.skipValue();
+		static const JsonKeySet keys = std::apply(
+				[](const auto &... field) {
+					JsonKeySet set;
+					(set.add(field.key), ...);
+					return set;
+				}, JsonFields<T>::fields);
+		if (!reader.enterObject())
+			return false;
+		int i;
+		while ((i = reader.nextKey(keys)) >= 0)
+			if (!readField(reader, value, i, std::make_index_sequence<count>()))
+				return false;
+		return reader.type() == JsonReader::END_OBJECT;
+	}
+
+	static void write(std::string &buffer, const T &value, int precision) {
+		bool first = true;
+		buffer.push_back('{');
+		std::apply([&](const auto &... field) {
+			(writeField(buffer, value, field, precision, first), ...);
+		}, JsonFields<T>::fields);
+		buffer.push_back('}');
+	}
+
+private:
+	static constexpr size_t count = std::tuple_size_v<
+			std::decay_t<decltype(JsonFields<T>::fields)>>;
+
+	template<size_t ... I>
+	static bool readField(JsonReader &reader, T &value, int index,
+			std::index_sequence<I...>) {
+		bool ok = true;
+		((index == (int) I ? (ok = readMember(reader, value,
+				std::get<I>(JsonFields<T>::fields)), true) : false) || ...);
+		return ok;
+	}
+
+	template<class S, class M>
+	static bool readMember(JsonReader &reader, T &value,
+			const JsonField<S, M> &field) {
+		return JsonCodec<M>::read(reader, value.*field.member);
+	}
+
+	template<class C, class M>
+	static auto present(const M &member, int) -> decltype(C::present(member)) {
+		return C::present(member);
+	}
+
+	template<class C, class M>
+	static bool present(const M&, long) {
+		return true;
+	}
+
+	template<class S, class M>
+	static void writeField(std::string &buffer, const T &value,
+			const JsonField<S, M> &field, int precision, bool &first) {
+		const M &member = value.*field.member;
+		if (!present<JsonCodec<M>>(member, 0))
+			return;
+		if (!first)
+			buffer.push_back(',');
+		first = false;
+		JsonBindSupport::appendString(buffer, field.key.data(),
+				field.key.length());
+		buffer.push_back(':');
+		JsonCodec<M>::write(buffer, member, precision);
+	}
+};
+
+/**
+ * class: JsonBind
+ *
+ * Decodes JSON straight into C++ structs and encodes them back, without
+ * building a JsonHandle tree.  Reading uses JsonReader and writing uses
+ * the same formatting as JsonHandle::toCompactString().  Structs are
+ * described with JsonFields and may hold numbers, booleans, strings,
+ * std::vector, std::optional, other described structs and JsonHandle for
+ * parts whose layout is not known.  Needs C++17.
+ *
+ * For example:
+ *    struct Point { int x; int y; std::optional<std::string> label; };
+ *    template<> struct JsonFields<Point> {
+ *       static constexpr auto fields = std::make_tuple(
+ *             JsonField("x", &Point::x),
+ *             JsonField("y", &Point::y),
+ *             JsonField("label", &Point::label));
+ *    };
+ *
+ *    Point p;
+ *    JsonError error;
+ *    if (JsonBind::fromString(text, p, error))
+ *       JsonBind::toString(p, buffer);
+ *
+ * Members missing from the input keep their values and values of the
+ * wrong type are skipped.  Empty optionals and undefined handles are
+ * left out of the output.
+ */
+class JsonBind {
+public:
+
+	/**
+	 * fromReader: decodes the value the reader is positioned on, or the
+	 *   next value if the current one was already passed.
+	 * @returns
+	 *   false on syntax error, see JsonReader::error().
+	 */
+	template<class T>
+	static bool fromReader(JsonReader &reader, T &value) {
+		if (!reader.hasValue())
+			reader.next();
+		if (!reader.hasValue())
+			return false;
+		return JsonCodec<T>::read(reader, value)
+				&& reader.errorCode() == JsonError::NONE;
+	}
+
+	/**
+	 * fromString: decodes length bytes of from into value, with
+	 *   JsonHandle::defaultParseOptions.  On failure the reason is stored
+	 *   in error, see JsonError.
+	 */
+	template<class T>
+	static bool fromString(const char *from, size_t length, T &value,
+			JsonError &error) {
+		JsonReader reader(from, length);
+		reader.setOptions(JsonHandle::defaultParseOptions);
+		error = JsonError();
+		if (fromReader(reader, value))
+			return true;
+		error.code = (reader.errorCode() != JsonError::NONE) ?
+				reader.errorCode() : JsonError::NO_VALUE;
+		error.offset = reader.offset();
+		error.depth = reader.depth();
+		return false;
+	}
+
+	/**
+	 * fromString: decodes from into value.  On failure the reason is
+	 *   stored in error, see JsonError.
+	 */
+	template<class T>
+	static bool fromString(const std::string &from, T &value,
+			JsonError &error) {
+		return fromString(from.data(), from.length(), value, error);
+	}
+
+	/**
+	 * toString: JSON encodes value into the provided string buffer,
+	 *   without whitespace.
+	 */
+	template<class T>
+	static std::string &toString(const T &value, std::string &buffer,
+			int precision = JsonHandle::defaultPrecision) {
+		buffer.clear();
+		JsonCodec<T>::write(buffer, value, precision);
+		return buffer;
+	}
+};
+
+#endif /* JSON_HAS_CXX17 */
+
+#endif /* __JSONBIND_H__ */
@@ -0,0 +1,391 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * The frozen data is a vector of words.  Each value starts with a word
+ * holding its _JS0 type in the low 8 bits and a count above them:
+ *
+ *   null, undefined   [type]
+ *   boolean           [type | value << 8]
+ *   long, ulong       [type] [value]
+ *   double            [type] [long double, in DOUBLE_WORDS words]
+ *   string            [type | length << 8] [bytes, '\0', padding]
+ *   array             [type | size << 8] [offset of each value] values
+ *   object            [type | size << 8] [hash << 32 | offset of each key]
+ *                     key string, value, key string, value...
+ *
+ * Offsets are in words from the start of the array or object, 32 bits
+ * for objects so an object can hold up to 32 GB.  Keys are stored as
+ * strings.
+ */
+
+#include "JsonFrozen.h"
+#include "_JS0.h"
+#include "JsonReader.h"
+#include <string>
+#include <vector>
+#include <string.h>
+
+static const size_t DOUBLE_WORDS = (sizeof(long double) + 7) / 8;
+
+bool JsonFrozenView::isNull() const {
+	return type() == _JS0::NULLVALUE;
+}
+
+bool JsonFrozenView::isArray() const {
+	return type() == _JS0::ARRAY;
+}
+
+bool JsonFrozenView::isObject() const {
+	return type() == _JS0::OBJECT;
+}
+
+bool JsonFrozenView::isString() const {
+	return type() == _JS0::STRING;
+}
+
+bool JsonFrozenView::isNumber() const {
+	unsigned t = type();
+	return t == _JS0::NUMBER_LONG || t == _JS0::NUMBER_ULONG
+			|| t == _JS0::NUMBER_DOUBLE;
+}
+
+bool JsonFrozenView::isBoolean() const {
+	return type() == _JS0::BOOLEAN;
+}
+
+unsigned JsonFrozenView::type() const {
+	return p ? (unsigned) (*p & 0xff) : _JS0::UNDEFINED;
+}
+
+JsonFrozenView JsonFrozenView::operator[](int index) const {
+	unsigned t = type();
+	if ((t == _JS0::ARRAY || t == _JS0::OBJECT) && index >= 0
+			&& (uint64_t) index < (*p >> 8))
+		return JsonFrozenView(
+				t == _JS0::ARRAY ? p + p[1 + index] : member(p, p[1 + index]));
+	return JsonFrozenView();
+}
+
+JsonFrozenView JsonFrozenView::operator[](const char *key) const {
+	if (!key)
+		return JsonFrozenView();
+	size_t length = strlen(key);
+	return JsonFrozenView(find(key, length, JsonKey::hash(key, length)));
+}
+
+JsonFrozenView JsonFrozenView::operator[](std::string const &key) const {
+	return JsonFrozenView(
+			find(key.data(), key.length(),
+					JsonKey::hash(key.data(), key.length())));
+}
+
+JsonFrozenView JsonFrozenView::operator[](JsonKey const &key) const {
+	return JsonFrozenView(find(key.data(), key.length(), key.hashValue()));
+}
+
+const uint64_t *
+JsonFrozenView::find(const char *key, size_t length, uint32_t hash) const {
+	if (type() != _JS0::OBJECT)
+		return 0;
+	// from the end, so the last of duplicate keys is found as in JsonView
+	for (size_t i = (size_t) (*p >> 8); i-- > 0;) {
+		uint64_t e = p[1 + i];
+		if ((uint32_t) (e >> 32) == hash) {
+			const uint64_t *k = p + (uint32_t) e;
+			if ((*k >> 8) == length && memcmp(k + 1, key, length) == 0)
+				return k + stringWords(length);
+		}
+	}
+	return 0;
+}
+
+const char *
+JsonFrozenView::key(int index) const {
+	if (type() == _JS0::OBJECT && index >= 0 && (uint64_t) index < (*p >> 8))
+		return (const char *) (p + (uint32_t) p[1 + index] + 1);
+	return "";
+}
+
+bool JsonFrozenView::exists(const char *key) const {
+	return (*this)[key].p != 0;
+}
+
+bool JsonFrozenView::exists(std::string const &key) const {
+	return (*this)[key].p != 0;
+}
+
+bool JsonFrozenView::exists(JsonKey const &key) const {
+	return (*this)[key].p != 0;
+}
+
+int JsonFrozenView::extract(const JsonKeySet &keys,
+		JsonFrozenView values[]) const {
+	int n = keys.size();
+	for (int i = 0; i < n; i++)
+		values[i].p = 0;
+	if (type() != _JS0::OBJECT)
+		return 0;
+	int found = 0;
+	size_t len = (size_t) (*p >> 8);
+	for (size_t i = 0; i < len; i++) {
+		uint64_t e = p[1 + i];
+		const uint64_t *k = p + (uint32_t) e;
+		int j = keys.find((const char *) (k + 1), (size_t) (*k >> 8),
+				(uint32_t) (e >> 32));
+		if (j >= 0) {
+			if (!values[j].p)
+				found++;
+			values[j].p = member(p, e);
+		}
+	}
+	return found;
+}
+
+int JsonFrozenView::size() const {
+	unsigned t = type();
+	return (t == _JS0::ARRAY || t == _JS0::OBJECT) ? (int) (*p >> 8) : 0;
+}
+
+bool JsonFrozenView::booleanValue(bool defaultValue) const {
+	if (type() == _JS0::BOOLEAN)
+		return (*p >> 8) != 0;
+	if (isNumber())
+		return longValue() ? true : false;
+	return defaultValue;
+}
+
+int64_t JsonFrozenView::longValue(int64_t defaultValue) const {
+	switch (type()) {
+	case _JS0::NUMBER_LONG:
+		return (int64_t) p[1];
+	case _JS0::NUMBER_ULONG:
+		return JsonReader::clampInt64(p[1]);
+	case _JS0::NUMBER_DOUBLE:
+		return JsonReader::clampInt64(doubleValue());
+	case _JS0::BOOLEAN:
+		return (*p >> 8) ? 1 : 0;
+	default:
+		return defaultValue;
+	}
+}
+
+uint64_t JsonFrozenView::ulongValue(uint64_t defaultValue) const {
+	switch (type()) {
+	case _JS0::NUMBER_LONG:
+		return (int64_t) p[1] < 0 ? 0 : p[1];
+	case _JS0::NUMBER_ULONG:
+		return p[1];
+	case _JS0::NUMBER_DOUBLE:
+		return JsonReader::clampUInt64(doubleValue());
+	case _JS0::BOOLEAN:
+		return (*p >> 8) ? 1 : 0;
+	default:
+		return defaultValue;
+	}
+}
+
+long double JsonFrozenView::doubleValue(long double defaultValue) const {
+	switch (type()) {
+	case _JS0::NUMBER_LONG:
+		return (long double) (int64_t) p[1];
+	case _JS0::NUMBER_ULONG:
+		return (long double) p[1];
+	case _JS0::NUMBER_DOUBLE: {
+		long double d;
+		memcpy(&d, p + 1, sizeof(d));
+		return d;
+	}
+	case _JS0::BOOLEAN:
+		return (*p >> 8) ? 1 : 0;
+	default:
+		return defaultValue;
+	}
+}
+
+std::string JsonFrozenView::stringValue() const {
+	if (type() == _JS0::STRING)
+		return std::string((const char *) (p + 1), (size_t) (*p >> 8));
+	return std::string();
+}
+
+const char *
+JsonFrozenView::stringValuePtr(const char *defaultValue) const {
+	return type() == _JS0::STRING ? (const char *) (p + 1) : defaultValue;
+}
+
+size_t JsonFrozenView::stringLength() const {
+	return type() == _JS0::STRING ? (size_t) (*p >> 8) : 0;
+}
+
+JsonFrozenView::iterator JsonFrozenView::bounds(bool end) const {
+	iterator i;
+	unsigned t = type();
+	if (t == _JS0::ARRAY || t == _JS0::OBJECT) {
+		i.base = p;
+		i.e = p + 1;
+		i.keyed = t == _JS0::OBJECT;
+		if (end)
+			i.e += *p >> 8;
+	}
+	return i;
+}
+
+JsonFrozenView::item_range JsonFrozenView::items() const {
+	item_range r;
+	if (type() == _JS0::OBJECT) {
+		r.first.base = r.last.base = p;
+		r.first.e = p + 1;
+		r.last.e = r.first.e + (*p >> 8);
+	}
+	return r;
+}
+
+/*
+ * Appends a string value of length characters to tape.
+ */
+void JsonFrozen::appendString(std::vector<uint64_t> &tape, const char *s,
+		size_t length) {
+	size_t at = tape.size();
+	tape.resize(at + 1 + (length + 8) / 8, 0);
+	tape[at] = _JS0::STRING | (uint64_t) length << 8;
+	memcpy(&tape[at + 1], s, length);
+}
+
+/*
+ * Appends the walked tree to tape.  An array or object gets its header
+ * and an empty offset table, filled in as its members are appended.
+ */
+struct JsonFrozen::builder {
+	std::vector<uint64_t> &tape;
+	std::vector<size_t> starts; // of the open arrays and objects
+
+	builder(std::vector<uint64_t> &tape) :
+			tape(tape) {
+	}
+
+	bool open(const _JS0 *node, size_t) {
+		size_t at = tape.size();
+		size_t len = node->length();
+		tape.resize(at + 1 + len);
+		tape[at] = node->type | (uint64_t) len << 8;
+		if (node->packed) {
+			appendPacked(node->value.pack, at);
+			return false;
+		}
+		starts.push_back(at);
+		return true;
+	}
+
+	// the members of a packed array, whose offset table starts at at
+	void appendPacked(const _JS0::packedArray *p, size_t at) {
+		size_t len = p->size();
+		for (size_t i = 0; i < len; i++) {
+			tape[at + 1 + i] = tape.size() - at;
+			appendMember(p, i);
+		}
+	}
+
+	void appendMember(const _JS0::packedArray *p, size_t i) {
+		if (p->type == _JS0::NUMBER_LONG)
+			appendLong(p->lng[i]);
+		else
+			appendDouble(p->dbl[i]);
+	}
+
+	void appendLong(int64_t value) {
+		tape.push_back(_JS0::NUMBER_LONG);
+		tape.push_back((uint64_t) value);
+	}
+
+	void appendDouble(const long double &value) {
+		size_t at = tape.size();
+		tape.resize(at + 1 + DOUBLE_WORDS, 0);
+		tape[at] = _JS0::NUMBER_DOUBLE;
+		memcpy(&tape[at + 1], &value, sizeof(value));
+	}
+
+	const _JS0 *member(const _JS0 *node, size_t index, size_t) {
+		size_t at = starts.back();
+		if (node->type == _JS0::OBJECT) {
+			const _JS0::entry *e = node->value.obj->at(index);
+			tape[at + 1 + index] = (uint64_t) e->hash << 32 | (tape.size() - at);
+			appendString(tape, e->key.data(), e->key.length());
+			return e->node;
+		}
+		tape[at + 1 + index] = tape.size() - at;
+		return node->value.arr->at(index);
+	}
+
+	void close(const _JS0 *, size_t) {
+		starts.pop_back();
+	}
+
+	void leaf(const _JS0 *node, size_t) {
+		if (node->aux
+				&& (node->aux->flags & (_JS0::RAW_NUMBER | _JS0::RAW_DECODED))
+						== _JS0::RAW_NUMBER)
+			node->decodeRawNumber();
+		size_t at = tape.size();
+		switch (node->type) {
+		case _JS0::STRING:
+			appendString(tape, node->value.str->data(),
+					node->value.str->length());
+			break;
+		case _JS0::NUMBER_LONG:
+		case _JS0::NUMBER_ULONG:
+			tape.push_back(node->type);
+			tape.push_back(node->value.ulng);
+			break;
+		case _JS0::NUMBER_DOUBLE:
+			tape.resize(at + 1 + DOUBLE_WORDS, 0);
+			tape[at] = node->type;
+			memcpy(&tape[at + 1], &node->value.dbl, sizeof(node->value.dbl));
+			break;
+		case _JS0::BOOLEAN:
+			tape.push_back(
+					node->type | (uint64_t) (node->value.boo ? 1 : 0) << 8);
+			break;
+		default:
+			tape.push_back(node->type);
+			break;
+		}
+	}
+};
+
+void JsonFrozen::freeze(JsonView from) {
+	std::vector<uint64_t> t;
+	if (const int64_t *l = from.longMember()) {
+		builder b(t);
+		b.appendLong(*l);
+	} else if (const long double *d = from.doubleMember()) {
+		builder b(t);
+		b.appendDouble(*d);
+	} else if (from.node()) {
+		builder b(t);
+		_JS0::walk(from.node(), b);
+	}
+	// exactly the size needed, the data is kept for a long time
+	std::vector<uint64_t>(t).swap(tape);
+}
@@ -0,0 +1,607 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __JSONFROZEN_H__
+#define __JSONFROZEN_H__
+
+#include <iterator>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "JsonKey.h"
+#include "JsonView.h"
+
+/**
+ * class: JsonFrozenView
+ *
+ * A read only look at data in a JsonFrozen, with the getters and lookups
+ * of JsonView.  Like a JsonView it is a single pointer that never
+ * allocates, and as the data can not change any number of threads may
+ * read through views at once without locks.
+ *
+ * For example:
+ *    JsonFrozen config(root);
+ *    JsonFrozenView v = config;
+ *    int port = (int) v["server"]["port"].longValue(80);
+ *
+ * Strings and keys are kept in the frozen data, so they are read as
+ * characters, stringValue() makes a copy.  A view is valid as long as
+ * the JsonFrozen it came from.
+ */
+class JsonFrozenView {
+	friend class JsonFrozen;
+public:
+
+	/**
+	 * Constructor - creates an undefined view.
+	 */
+	JsonFrozenView() :
+			p(0) {
+	}
+
+	/**
+	 * isDefined - tests if the view refers to actual data.  Note that
+	 *    Null is a defined type.
+	 */
+	bool isDefined() const {
+		return p != 0;
+	}
+
+	/**
+	 * isNull - tests if the current data is of type Null.
+	 */
+	bool isNull() const;
+
+	/**
+	 * isArray - tests if the current data is of type Array.
+	 */
+	bool isArray() const;
+
+	/**
+	 * isObject - tests if the current data is of type Object.
+	 */
+	bool isObject() const;
+
+	/**
+	 * isString - tests if the current data is of type String.
+	 */
+	bool isString() const;
+
+	/**
+	 * isNumber - tests if the current data is of type Number.
+	 */
+	bool isNumber() const;
+
+	/**
+	 * isBoolean - tests if the current data is of type Boolean.
+	 */
+	bool isBoolean() const;
+
+	/**
+	 * operator[](int) - the value at index of an array or object.
+	 */
+	JsonFrozenView operator[](int index) const;
+
+	/**
+	 * operator[](char *) - the value at key of an object.
+	 */
+	JsonFrozenView operator[](const char *key) const;
+
+	/**
+	 * operator[](std::string &) - the value at key of an object.
+	 */
+	JsonFrozenView operator[](std::string const &key) const;
+
+	/**
+	 * operator[](JsonKey &) - the value at key of an object.
+	 */
+	JsonFrozenView operator[](JsonKey const &key) const;
+
+	/**
+	 * at(int) - Same as operator[int]
+	 */
+	JsonFrozenView at(int index) const {
+		return (*this)[index];
+	}
+
+	/**
+	 * at(char *) - Same as operator[char *]
+	 */
+	JsonFrozenView at(const char *key) const {
+		return (*this)[key];
+	}
+
+	/**
+	 * at(string &) - Same as operator[string &]
+	 */
+	JsonFrozenView at(std::string const &key) const {
+		return (*this)[key];
+	}
+
+	/**
+	 * at(JsonKey &) - Same as operator[JsonKey &]
+	 */
+	JsonFrozenView at(JsonKey const &key) const {
+		return (*this)[key];
+	}
+
+	/**
+	 * key - returns the object's key at the specified index, or "".  Only
+	 * valid for object types.
+	 */
+	const char *key(int index) const;
+
+	/**
+	 * exists - checks whether a specific key is present.
+	 */
+	bool exists(const char *key) const;
+
+	/**
+	 * exists - checks whether a specific key is present.
+	 */
+	bool exists(std::string const &key) const;
+
+	/**
+	 * exists - checks whether a specific key is present.
+	 */
+	bool exists(JsonKey const &key) const;
+
+	/**
+	 * extract - looks up all the keys of an object in a single pass, see
+	 *   JsonView::extract().
+	 * @returns
+	 *   the number of keys found.
+	 */
+	int extract(const JsonKeySet &keys, JsonFrozenView values[]) const;
+
+	/**
+	 * size()
+	 *    if view is an Array - size of array.
+	 *    if view is an Object - number of object properties.
+	 *    otherwise 0
+	 */
+	int size() const;
+
+	/**
+	 * booleanValue: gets the boolean value.  Numbers are true when
+	 *   not zero, strings are not converted.
+	 * @returns
+	 *   value or defaultValue.
+	 */
+	bool booleanValue(bool defaultValue = false) const;
+
+	/**
+	 * longValue: gets the long value of a number or boolean.  Numbers
+	 *   out of range are clamped.
+	 * @returns
+	 *   value or defaultValue.
+	 */
+	int64_t longValue(int64_t defaultValue = 0) const;
+
+	/**
+	 * ulongValue: gets the unsigned long value of a number or boolean.
+	 *   Numbers out of range are clamped.
+	 * @returns
+	 *   value or defaultValue.
+	 */
+	uint64_t ulongValue(uint64_t defaultValue = 0) const;
+
+	/**
+	 * doubleValue: gets the double value of a number or boolean.
+	 * @returns
+	 *   value or defaultValue.
+	 */
+	long double doubleValue(long double defaultValue = 0) const;
+
+	/**
+	 * stringValue: gets a copy of the string value.  Numbers and
+	 *   booleans are not converted.
+	 * @returns
+	 *   value or an empty string.
+	 */
+	std::string stringValue() const;
+
+	/**
+	 * stringValuePtr: gets the string value, which ends with a '\0'.
+	 *   Numbers and booleans are not converted.
+	 * @returns
+	 *   value or defaultValue.
+	 */
+	const char *stringValuePtr(const char *defaultValue = NULL) const;
+
+	/**
+	 * stringLength: the length of the string value, for strings holding
+	 *   '\0'.
+	 * @returns
+	 *   length or 0.
+	 */
+	size_t stringLength() const;
+
+	/**
+	 * iterator - random access over the values of an array or object,
+	 *    in order.  Dereferencing gives a JsonFrozenView.
+	 */
+	class iterator {
+		friend class JsonFrozenView;
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef JsonFrozenView value_type;
+		typedef ptrdiff_t difference_type;
+		typedef void pointer;
+		typedef JsonFrozenView reference;
+
+		iterator() :
+				base(0), e(0), keyed(false) {
+		}
+
+		JsonFrozenView operator*() const {
+			return JsonFrozenView(keyed ? member(base, *e) : base + *e);
+		}
+
+		JsonFrozenView operator[](difference_type n) const {
+			return *(*this + n);
+		}
+
+		iterator &operator+=(difference_type n) {
+			e += n;
+			return *this;
+		}
+
+		iterator &operator-=(difference_type n) {
+			e -= n;
+			return *this;
+		}
+
+		iterator &operator++() {
+			++e;
+			return *this;
+		}
+
+		iterator &operator--() {
+			--e;
+			return *this;
+		}
+
+		iterator operator++(int) {
+			iterator i(*this);
+			++e;
+			return i;
+		}
+
+		iterator operator--(int) {
+			iterator i(*this);
+			--e;
+			return i;
+		}
+
+		iterator operator+(difference_type n) const {
+			iterator i(*this);
+			return i += n;
+		}
+
+		iterator operator-(difference_type n) const {
+			iterator i(*this);
+			return i -= n;
+		}
+
+		difference_type operator-(const iterator &other) const {
+			return e - other.e;
+		}
+
+		bool operator==(const iterator &other) const {
+			return e == other.e;
+		}
+
+		bool operator!=(const iterator &other) const {
+			return e != other.e;
+		}
+
+		bool operator<(const iterator &other) const {
+			return e < other.e;
+		}
+
+		bool operator>(const iterator &other) const {
+			return e > other.e;
+		}
+
+		bool operator<=(const iterator &other) const {
+			return e <= other.e;
+		}
+
+		bool operator>=(const iterator &other) const {
+			return e >= other.e;
+		}
+
+	private:
+		const uint64_t *base; // the array or object
+		const uint64_t *e; // its entry for the value
+		bool keyed;
+	};
+
+	typedef iterator const_iterator;
+
+	/**
+	 * item - a key and value of an object, see items().
+	 */
+	struct item;
+
+	/**
+	 * item_iterator - random access over the members of an object.
+	 *    Dereferencing gives an item.
+	 */
+	class item_iterator {
+		friend class JsonFrozenView;
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef item value_type;
+		typedef ptrdiff_t difference_type;
+		typedef void pointer;
+		typedef item reference;
+
+		item_iterator() :
+				base(0), e(0) {
+		}
+
+		item operator*() const;
+
+		item operator[](difference_type n) const;
+
+		item_iterator &operator+=(difference_type n) {
+			e += n;
+			return *this;
+		}
+
+		item_iterator &operator-=(difference_type n) {
+			e -= n;
+			return *this;
+		}
+
+		item_iterator &operator++() {
+			++e;
+			return *this;
+		}
+
+		item_iterator &operator--() {
+			--e;
+			return *this;
+		}
+
+		item_iterator operator++(int) {
+			item_iterator i(*this);
+			++e;
+			return i;
+		}
+
+		item_iterator operator--(int) {
+			item_iterator i(*this);
+			--e;
+			return i;
+		}
+
+		item_iterator operator+(difference_type n) const {
+			item_iterator i(*this);
+			return i += n;
+		}
+
+		item_iterator operator-(difference_type n) const {
+			item_iterator i(*this);
+			return i -= n;
+		}
+
+		difference_type operator-(const item_iterator &other) const {
+			return e - other.e;
+		}
+
+		bool operator==(const item_iterator &other) const {
+			return e == other.e;
+		}
+
+		bool operator!=(const item_iterator &other) const {
+			return e != other.e;
+		}
+
+		bool operator<(const item_iterator &other) const {
+			return e < other.e;
+		}
+
+		bool operator>(const item_iterator &other) const {
+			return e > other.e;
+		}
+
+		bool operator<=(const item_iterator &other) const {
+			return e <= other.e;
+		}
+
+		bool operator>=(const item_iterator &other) const {
+			return e >= other.e;
+		}
+
+	private:
+		const uint64_t *base;
+		const uint64_t *e;
+	};
+
+	/**
+	 * item_range - what items() returns, for use with range for.
+	 */
+	struct item_range {
+		item_iterator first;
+		item_iterator last;
+
+		item_iterator begin() const {
+			return first;
+		}
+
+		item_iterator end() const {
+			return last;
+		}
+	};
+
+	/**
+	 * begin, end - iterators over the values of an array or object.
+	 *    Both are equal for other types.
+	 */
+	iterator begin() const {
+		return bounds(false);
+	}
+
+	iterator end() const {
+		return bounds(true);
+	}
+
+	/**
+	 * items - the key and value pairs of an object.  Empty for other
+	 *    types.
+	 */
+	item_range items() const;
+
+	/**
+	 * operator == - true when both views refer to the same data.
+	 */
+	bool operator ==(const JsonFrozenView &other) const {
+		return p == other.p;
+	}
+
+	bool operator !=(const JsonFrozenView &other) const {
+		return p != other.p;
+	}
+
+private:
+	explicit JsonFrozenView(const uint64_t *p) :
+			p(p) {
+	}
+
+	// words taken by a string of length characters, with its '\0'
+	static size_t stringWords(size_t length) {
+		return 1 + (length + 8) / 8;
+	}
+
+	// the value of the member of object base with entry e
+	static const uint64_t *member(const uint64_t *base, uint64_t e) {
+		const uint64_t *key = base + (uint32_t) e;
+		return key + stringWords((size_t) (*key >> 8));
+	}
+
+	unsigned type() const;
+
+	const uint64_t *find(const char *key, size_t length, uint32_t hash) const;
+
+	iterator bounds(bool end) const;
+
+	const uint64_t *p;
+};
+
+struct JsonFrozenView::item {
+	const char *key;
+	JsonFrozenView value;
+};
+
+inline JsonFrozenView::item JsonFrozenView::item_iterator::operator*() const {
+	item i = { (const char *) (base + (uint32_t) *e + 1), JsonFrozenView(
+			member(base, *e)) };
+	return i;
+}
+
+inline JsonFrozenView::item JsonFrozenView::item_iterator::operator[](
+		difference_type n) const {
+	return *(*this + n);
+}
+
+/**
+ * class: JsonFrozen
+ *
+ * An immutable copy of a document for data that is built once and then
+ * read for a long time, such as configuration, by any number of threads.
+ * The data is laid out depth first in one array of 64 bit words with no
+ * pointers and no reference counts: each value is a word holding its
+ * type and size, followed by its number or the bytes of its string.  An
+ * array or object is followed by a table of the offsets of its values,
+ * an object's table also holding the hash of each key, so indexes and
+ * keys are found without walking the values.  The result usually takes
+ * a fraction of the memory of the JsonHandle tree.
+ *
+ * For example:
+ *    JsonHandle root;
+ *    root.fromFile("config.json");
+ *    JsonFrozen config(root);
+ *    config.root()["limits"]["connections"].longValue();
+ *
+ * Views taken from a JsonFrozen are valid until it is frozen again or
+ * destroyed.
+ */
+class JsonFrozen {
+public:
+
+	/**
+	 * Constructor - creates an empty JsonFrozen, whose root is undefined.
+	 */
+	JsonFrozen() {
+	}
+
+	/**
+	 * Constructor - freezes a copy of from, see freeze().
+	 */
+	explicit JsonFrozen(JsonView from) {
+		freeze(from);
+	}
+
+	/**
+	 * freeze - replaces the frozen data with a copy of from.  Lazy
+	 *   numbers are converted, their text is not kept.
+	 */
+	void freeze(JsonView from);
+
+	/**
+	 * root - a view of the frozen data.
+	 */
+	JsonFrozenView root() const {
+		return JsonFrozenView(tape.empty() ? 0 : &tape[0]);
+	}
+
+	operator JsonFrozenView() const {
+		return root();
+	}
+
+	/**
+	 * memorySize - the number of bytes taken by the frozen data.
+	 */
+	size_t memorySize() const {
+		return tape.size() * sizeof(uint64_t);
+	}
+
+	void swap(JsonFrozen &other) {
+		tape.swap(other.tape);
+	}
+
+private:
+	struct builder;
+
+	static void appendString(std::vector<uint64_t> &tape, const char *s,
+			size_t length);
+
+	std::vector<uint64_t> tape;
+};
+
+#endif /* __JSONFROZEN_H__ */
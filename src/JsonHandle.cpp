@@ -24,7 +24,9 @@
 
 #include "JsonHandle.h"
 #include "_JS0.h"
+#include "JsonReader.h"
 #include <stdio.h>
+#include <string.h>
 #include <ios>
 
 #ifdef HAS_JSON_STATS
@@ -34,7 +36,7 @@ static struct stats {
 } stats;
 #endif
 
-#define PRINTERR(foo,msg) fprintf(stderr,"JsonHandle::%s: %s\n", foo, msg)
+#define PRINTERR(foo,msg) (JsonHandle::errorFunction ? JsonHandle::errorFunction(foo, msg) : (void) 0)
 
 #define STATE_NEW_NODE 0
 #define STATE_HAS_NODE 1
@@ -42,9 +44,20 @@ static struct stats {
 #define STATE_NEW_CHILD_BY_STLKEY 3
 #define STATE_NEW_CHILD_BY_INDEX 4
 #define STATE_ORPHAN 5
+#define STATE_NEW_CHILD_BY_JSONKEY 6
 
 const std::string JsonHandle::EMPTY_STRING;
+static const std::string TRUE_STRING("true");
+static const std::string FALSE_STRING("false");
 int JsonHandle::defaultPrecision = 4;
+bool JsonHandle::copyOnWrite = false;
+bool JsonHandle::deferredFree = false;
+JsonParseOptions JsonHandle::defaultParseOptions;
+JsonHandle::ErrorFunction JsonHandle::errorFunction = 0;
+
+void JsonHandle::printError(const char *function, const char *message) {
+	fprintf(stderr, "JsonHandle::%s: %s\n", function, message);
+}
 
 JsonHandle JsonHandle::JSON_ERROR(NULL);
 
@@ -74,6 +87,21 @@ JsonHandle::JsonHandle(const JsonHandle &from) :
 		parent->reserve();
 }
 
+/*
+ * The move constructor.  The reference counts held by from pass to this
+ * handle.
+ */
+void JsonHandle::moveFrom(JsonHandle &from) {
+#ifdef HAS_JSON_STATS
+	stats.allocs++;
+#endif
+	parent = from.parent;
+	state = from.state;
+	vapor = from.vapor;
+	from.parent = 0;
+	from.state = STATE_NEW_NODE;
+}
+
 JsonHandle::JsonHandle() :
 		parent(0), state(STATE_NEW_NODE) {
 #ifdef HAS_JSON_STATS
@@ -144,8 +172,19 @@ JsonHandle::JsonHandle(_JS0 *parent, const std::string &key) :
 	vapor.stlkey = &key;
 }
 
+JsonHandle::JsonHandle(_JS0 *parent, const JsonKey &key) :
+		parent(parent) {
+#ifdef HAS_JSON_STATS
+	stats.allocs++;
+#endif
+	parent->reserve();
+	state = STATE_NEW_CHILD_BY_JSONKEY;
+	vapor.jsonkey = &key;
+}
+
 JsonHandle &
 JsonHandle::copy(const JsonHandle &from) {
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("copy()");
 		if (state != STATE_HAS_NODE
@@ -154,7 +193,7 @@ JsonHandle::copy(const JsonHandle &from) {
 	}
 	if (from.state == STATE_HAS_NODE
 	)
-		vapor.node->copy(*(from.vapor.node));
+		vapor.node->copy(*(from.vapor.node), copyOnWrite);
 	else
 		vapor.node->setBoolean(false);
 	return *this;
@@ -163,7 +202,7 @@ JsonHandle::copy(const JsonHandle &from) {
 JsonHandle &
 JsonHandle::operator=(const JsonHandle &from) {
 	if (&from != this && from.state == STATE_HAS_NODE) {
-
+		unshare();
 		if (state != STATE_HAS_NODE) {
 			if (state != STATE_HAS_NODE) {
 				makeVaporNode("operator[](int)");
@@ -172,12 +211,51 @@ JsonHandle::operator=(const JsonHandle &from) {
 					return JsonHandle::JSON_ERROR;
 			}
 		}
-		vapor.node->copy(*from.vapor.node);
+		vapor.node->copy(*from.vapor.node, copyOnWrite);
+	}
+	return *this;
+}
+
+JsonHandle &
+JsonHandle::moveAssign(JsonHandle &from) {
+	if (&from == this || from.state != STATE_HAS_NODE)
+		return *this;
+	if (from.vapor.node->ref_count != 1)
+		return *this = (const JsonHandle &) from;
+	unshare();
+	if (state != STATE_HAS_NODE) {
+		makeVaporNode("operator=()");
+		if (state != STATE_HAS_NODE)
+			return JsonHandle::JSON_ERROR;
+	}
+	vapor.node->take(*from.vapor.node);
+	return *this;
+}
+
+JsonHandle &
+JsonHandle::adoptFrom(JsonHandle &from) {
+	if (&from == this || from.state != STATE_HAS_NODE)
+		return *this;
+	unshare();
+	if (state != STATE_HAS_NODE) {
+		makeVaporNode("adopt()");
+		if (state != STATE_HAS_NODE)
+			return JsonHandle::JSON_ERROR;
 	}
+	_JS0 *node = from.vapor.node;
+	if (node == vapor.node)
+		return *this;
+	if (from.parent)
+		from.parent->detach(node);
+	if (node->links > 0) // still shared after a copy on write
+		vapor.node->copy(*node, true);
+	else
+		vapor.node->take(*node);
 	return *this;
 }
 
 JsonHandle JsonHandle::operator[](int index) {
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("operator[](int)");
 		if (state != STATE_HAS_NODE
@@ -192,7 +270,9 @@ JsonHandle JsonHandle::operator[](int index) {
 		PRINTERR("operator[](int)", "index out of bounds");
 		return JsonHandle::JSON_ERROR;
 	}
-	_JS0 *n = vapor.node->getByIndex(index);
+	if (vapor.node->packed) // a handle needs a node to refer to
+		vapor.node->unpack();
+	_JS0 *n = vapor.node->own(vapor.node->getByIndex(index));
 	return n ? JsonHandle(n, vapor.node) : JsonHandle(vapor.node, index);
 }
 
@@ -202,6 +282,7 @@ JsonHandle JsonHandle::operator[](const char *key) {
 		PRINTERR("operator[](char *)", "null key pointer");
 		return JsonHandle::JSON_ERROR;
 	}
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("operator[](char *)");
 		if (state != STATE_HAS_NODE
@@ -209,11 +290,12 @@ JsonHandle JsonHandle::operator[](const char *key) {
 			return JsonHandle::JSON_ERROR;
 		vapor.node->setObject();
 	}
-	_JS0 *n = vapor.node->getByKey(key);
+	_JS0 *n = vapor.node->own(vapor.node->getByKey(key));
 	return n ? JsonHandle(n, vapor.node) : JsonHandle(vapor.node, key);
 }
 
 JsonHandle JsonHandle::operator[](const std::string &key) {
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("operator[](string &)");
 		if (state != STATE_HAS_NODE
@@ -221,11 +303,25 @@ JsonHandle JsonHandle::operator[](const std::string &key) {
 			return JsonHandle::JSON_ERROR;
 		vapor.node->setObject();
 	}
-	_JS0 *n = vapor.node->getByKey(key);
+	_JS0 *n = vapor.node->own(vapor.node->getByKey(key));
+	return n ? JsonHandle(n, vapor.node) : JsonHandle(vapor.node, key);
+}
+
+JsonHandle JsonHandle::operator[](const JsonKey &key) {
+	unshare();
+	if (state != STATE_HAS_NODE) {
+		makeVaporNode("operator[](JsonKey &)");
+		if (state != STATE_HAS_NODE
+		)
+			return JsonHandle::JSON_ERROR;
+		vapor.node->setObject();
+	}
+	_JS0 *n = vapor.node->own(vapor.node->getByKey(key));
 	return n ? JsonHandle(n, vapor.node) : JsonHandle(vapor.node, key);
 }
 
 JsonHandle JsonHandle::at(int index) {
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("at(int)");
 		if (state != STATE_HAS_NODE
@@ -240,7 +336,9 @@ JsonHandle JsonHandle::at(int index) {
 		PRINTERR("at(int)", "index out of bounds");
 		return JsonHandle::JSON_ERROR;
 	}
-	_JS0 *n = vapor.node->getByIndex(index);
+	if (vapor.node->packed) // a handle needs a node to refer to
+		vapor.node->unpack();
+	_JS0 *n = vapor.node->own(vapor.node->getByIndex(index));
 	return n ? JsonHandle(n, vapor.node) : JsonHandle(vapor.node, index);
 }
 
@@ -250,6 +348,7 @@ JsonHandle JsonHandle::at(const char *key) {
 		PRINTERR("at(char *)", "null key pointer");
 		return JsonHandle::JSON_ERROR;
 	}
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("at(char *)");
 		if (state != STATE_HAS_NODE
@@ -257,11 +356,12 @@ JsonHandle JsonHandle::at(const char *key) {
 			return JsonHandle::JSON_ERROR;
 		vapor.node->setObject();
 	}
-	_JS0 *n = vapor.node->getByKey(key);
+	_JS0 *n = vapor.node->own(vapor.node->getByKey(key));
 	return n ? JsonHandle(n, vapor.node) : JsonHandle(vapor.node, key);
 }
 
 JsonHandle JsonHandle::at(const std::string &key) {
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("operator[](string &)");
 		if (state != STATE_HAS_NODE
@@ -269,7 +369,20 @@ JsonHandle JsonHandle::at(const std::string &key) {
 			return JsonHandle::JSON_ERROR;
 		vapor.node->setObject();
 	}
-	_JS0 *n = vapor.node->getByKey(key);
+	_JS0 *n = vapor.node->own(vapor.node->getByKey(key));
+	return n ? JsonHandle(n, vapor.node) : JsonHandle(vapor.node, key);
+}
+
+JsonHandle JsonHandle::at(const JsonKey &key) {
+	unshare();
+	if (state != STATE_HAS_NODE) {
+		makeVaporNode("at(JsonKey &)");
+		if (state != STATE_HAS_NODE
+		)
+			return JsonHandle::JSON_ERROR;
+		vapor.node->setObject();
+	}
+	_JS0 *n = vapor.node->own(vapor.node->getByKey(key));
 	return n ? JsonHandle(n, vapor.node) : JsonHandle(vapor.node, key);
 }
 
@@ -282,6 +395,7 @@ int JsonHandle::size() {
 
 JsonHandle&
 JsonHandle::setLong(int64_t x) {
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("setLong()");
 		if (state != STATE_HAS_NODE
@@ -292,8 +406,22 @@ JsonHandle::setLong(int64_t x) {
 	return *this;
 }
 
+JsonHandle&
+JsonHandle::setULong(uint64_t x) {
+	unshare();
+	if (state != STATE_HAS_NODE) {
+		makeVaporNode("setULong()");
+		if (state != STATE_HAS_NODE
+		)
+			return *this;
+	}
+	vapor.node->setULong(x);
+	return *this;
+}
+
 JsonHandle&
 JsonHandle::setBoolean(bool x) {
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("setBoolean()");
 		if (state != STATE_HAS_NODE
@@ -306,6 +434,7 @@ JsonHandle::setBoolean(bool x) {
 
 JsonHandle&
 JsonHandle::setDouble(long double x) {
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("setDouble()");
 		if (state != STATE_HAS_NODE
@@ -316,8 +445,35 @@ JsonHandle::setDouble(long double x) {
 	return *this;
 }
 
+JsonHandle&
+JsonHandle::assign(const double *x, size_t count) {
+	unshare();
+	if (state != STATE_HAS_NODE) {
+		makeVaporNode("assign()");
+		if (state != STATE_HAS_NODE
+		)
+			return *this;
+	}
+	vapor.node->assign(x, count);
+	return *this;
+}
+
+JsonHandle&
+JsonHandle::assign(const int64_t *x, size_t count) {
+	unshare();
+	if (state != STATE_HAS_NODE) {
+		makeVaporNode("assign()");
+		if (state != STATE_HAS_NODE
+		)
+			return *this;
+	}
+	vapor.node->assign(x, count);
+	return *this;
+}
+
 JsonHandle&
 JsonHandle::setString(const char *x) {
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("setString(char *)");
 		if (state != STATE_HAS_NODE
@@ -332,8 +488,26 @@ JsonHandle::setString(const char *x) {
 	return *this;
 }
 
+/*
+ * setString(string &&), the string's buffer is swapped into the node.
+ */
+JsonHandle&
+JsonHandle::takeString(std::string &x) {
+	unshare();
+	if (state != STATE_HAS_NODE) {
+		makeVaporNode("setString(string &&)");
+		if (state != STATE_HAS_NODE)
+			return *this;
+	}
+	vapor.node->setType(_JS0::STRING);
+	vapor.node->value.str->swap(x);
+	x.clear();
+	return *this;
+}
+
 JsonHandle&
 JsonHandle::setString(const std::string &x) {
+	unshare();
 	if (state != STATE_HAS_NODE) {
 		makeVaporNode("setString(string &)");
 		if (state != STATE_HAS_NODE
@@ -344,6 +518,19 @@ JsonHandle::setString(const std::string &x) {
 	return *this;
 }
 
+/*
+ * Before the node is changed, gives this handle its own copy when arrays
+ * or objects share it after a copy on write.
+ */
+void JsonHandle::unshare() {
+	if (state == STATE_HAS_NODE && parent && vapor.node->links > 1) {
+		_JS0 *n = parent->own(vapor.node);
+		n->reserve();
+		vapor.node->release();
+		vapor.node = n;
+	}
+}
+
 void JsonHandle::makeVaporNode(const char *foo) {
 	if (!parent && state == STATE_ORPHAN) {
 		PRINTERR(foo, "null reference error");
@@ -364,6 +551,10 @@ void JsonHandle::makeVaporNode(const char *foo) {
 			parent->setByKey(*(vapor.stlkey), n);
 		} else if (state == STATE_NEW_CHILD_BY_KEY) {
 			parent->setByKey(vapor.key, n);
+		} else if (state == STATE_NEW_CHILD_BY_JSONKEY) {
+			parent->setByKey(
+					std::string(vapor.jsonkey->data(), vapor.jsonkey->length()),
+					n);
 		} else {
 			parent->setByIndex(vapor.index, n);
 		}
@@ -372,54 +563,47 @@ void JsonHandle::makeVaporNode(const char *foo) {
 	state = STATE_HAS_NODE;
 }
 
-static bool parseLong(const std::string &s, int64_t &value) {
+/*
+ * Converts a string holding an integer or, when decimal is set, a number
+ * with a fractional part.
+ * @returns
+ *    the kind of number from JsonReader::convertNumber() or -1.
+ */
+static int parseNumber(const std::string &s, bool decimal, int64_t &lng,
+		uint64_t &ulng, long double &dbl) {
 	const char *p = s.c_str();
-	bool isneg = (*p == '-');
-	if (isneg)
+	if (*p == '-')
 		p++;
 	if (*p < '0' || *p > '9')
-		return false;
-	value = *p++ - '0';
-	while (*p) {
-		if (*p < '0' || *p > '9')
-			return false;
-		value = value * 10 + (*p++ - '0');
-	}
-	if (isneg)
-		value = -value;
-	return true;
+		return -1;
+	while (*p >= '0' && *p <= '9')
+		p++;
+	if (decimal && *p == '.')
+		for (p++; *p >= '0' && *p <= '9'; p++)
+			;
+	if (p != s.c_str() + s.length())
+		return -1;
+	return JsonReader::convertNumber(s.data(), s.length(), lng, ulng, dbl);
+}
+
+static bool parseLong(const std::string &s, int64_t &value) {
+	uint64_t ulng;
+	long double dbl;
+	return parseNumber(s, false, value, ulng, dbl) == JsonReader::NUM_INT64;
+}
+
+static bool parseULong(const std::string &s, uint64_t &value) {
+	int64_t lng;
+	long double dbl;
+	int kind = parseNumber(s, false, lng, value, dbl);
+	return kind == JsonReader::NUM_UINT64
+			|| (kind == JsonReader::NUM_INT64 && lng >= 0);
 }
 
 static bool parseDouble(const std::string &s, long double &value) {
-	const char *p = s.c_str();
-	bool isneg = (*p == '-');
-	if (isneg)
-		p++;
-	if (*p < '0' || *p > '9')
-		return false;
-	int64_t ip = *p++ - '0';
-	while (*p) {
-		if (*p < '0' || *p > '9') {
-			if (*p == '.')
-				break;
-			return false;
-		}
-		ip = ip * 10 + (*p++ - '0');
-	}
-	value = (long double) ip;
-	if (*p == '.') {
-		p++;
-		ip = 10;
-		while (*p) {
-			if (*p < '0' || *p > '9')
-				return false;
-			value += (long double) (*p++ - '0') / (long double) ip;
-			ip *= 10;
-		}
-	}
-	if (isneg)
-		value = -value;
-	return true;
+	int64_t lng;
+	uint64_t ulng;
+	return parseNumber(s, true, lng, ulng, value) >= 0;
 }
 
 static bool parseBoolean(const std::string &s, bool &value) {
@@ -428,7 +612,7 @@ static bool parseBoolean(const std::string &s, bool &value) {
 
 	if (s.length() == 5) {
 		if (IS_LCC(0,'f') && IS_LCC(1,'a') && IS_LCC(2,'l') && IS_LCC(3,'s')
-				&& IS_LCC(3,'e')) {
+				&& IS_LCC(4,'e')) {
 			value = false;
 			return true;
 
@@ -472,18 +656,39 @@ static bool parseBoolean(const std::string &s, bool &value) {
 
 int64_t JsonHandle::longValue(int64_t defaultValue) const {
 	if (state == STATE_HAS_NODE) {
-		if (vapor.node->getType() == _JS0::NUMBER_LONG
-				|| vapor.node->getType() == _JS0::NUMBER_DOUBLE)
+		if (vapor.node->isNumber())
 			return vapor.node->longValue();
 		if (vapor.node->getType() == _JS0::BOOLEAN)
 			return vapor.node->booleanValue() ? 1 : 0;
 		if (vapor.node->getType() == _JS0::STRING) {
-			const std::string &s = vapor.node->stringValue();
-			int64_t value;
-			if (parseLong(s, value)) {
-				vapor.node->setLong(value);
-				return value;
+			_JS0::extra *x = vapor.node->getExtra();
+			if (!(x->flags & _JS0::LONG_CACHED)) {
+				x->flags |= _JS0::LONG_CACHED;
+				if (parseLong(vapor.node->stringValue(), x->lng))
+					x->flags |= _JS0::LONG_VALID;
+			}
+			if (x->flags & _JS0::LONG_VALID)
+				return x->lng;
+		}
+	}
+	return defaultValue;
+}
+
+uint64_t JsonHandle::ulongValue(uint64_t defaultValue) const {
+	if (state == STATE_HAS_NODE) {
+		if (vapor.node->isNumber())
+			return vapor.node->ulongValue();
+		if (vapor.node->getType() == _JS0::BOOLEAN)
+			return vapor.node->booleanValue() ? 1 : 0;
+		if (vapor.node->getType() == _JS0::STRING) {
+			_JS0::extra *x = vapor.node->getExtra();
+			if (!(x->flags & _JS0::ULONG_CACHED)) {
+				x->flags |= _JS0::ULONG_CACHED;
+				if (parseULong(vapor.node->stringValue(), x->ulng))
+					x->flags |= _JS0::ULONG_VALID;
 			}
+			if (x->flags & _JS0::ULONG_VALID)
+				return x->ulng;
 		}
 	}
 	return defaultValue;
@@ -493,16 +698,17 @@ bool JsonHandle::booleanValue(bool defaultValue) const {
 	if (state == STATE_HAS_NODE) {
 		if (vapor.node->getType() == _JS0::BOOLEAN)
 			return vapor.node->booleanValue();
-		if (vapor.node->getType() == _JS0::NUMBER_LONG
-				|| vapor.node->getType() == _JS0::NUMBER_DOUBLE)
+		if (vapor.node->isNumber())
 			return vapor.node->longValue() ? true : false;
 		if (vapor.node->getType() == _JS0::STRING) {
-			const std::string &s = vapor.node->stringValue();
-			bool value;
-			if (parseBoolean(s, value)) {
-				vapor.node->setBoolean(value);
-				return value;
+			_JS0::extra *x = vapor.node->getExtra();
+			if (!(x->flags & _JS0::BOOLEAN_CACHED)) {
+				x->flags |= _JS0::BOOLEAN_CACHED;
+				if (parseBoolean(vapor.node->stringValue(), x->boo))
+					x->flags |= _JS0::BOOLEAN_VALID;
 			}
+			if (x->flags & _JS0::BOOLEAN_VALID)
+				return x->boo;
 		}
 	}
 	return defaultValue;
@@ -510,18 +716,19 @@ bool JsonHandle::booleanValue(bool defaultValue) const {
 
 long double JsonHandle::doubleValue(long double defaultValue) const {
 	if (state == STATE_HAS_NODE) {
-		if (vapor.node->getType() == _JS0::NUMBER_DOUBLE
-				|| vapor.node->getType() == _JS0::NUMBER_LONG)
+		if (vapor.node->isNumber())
 			return vapor.node->doubleValue();
 		if (vapor.node->getType() == _JS0::BOOLEAN)
 			return vapor.node->booleanValue() ? 1 : 0;
 		if (vapor.node->getType() == _JS0::STRING) {
-			const std::string &s = vapor.node->stringValue();
-			long double value;
-			if (parseDouble(s, value)) {
-				vapor.node->setDouble(value);
-				return value;
+			_JS0::extra *x = vapor.node->getExtra();
+			if (!(x->flags & _JS0::DOUBLE_CACHED)) {
+				x->flags |= _JS0::DOUBLE_CACHED;
+				if (parseDouble(vapor.node->stringValue(), x->dbl))
+					x->flags |= _JS0::DOUBLE_VALID;
 			}
+			if (x->flags & _JS0::DOUBLE_VALID)
+				return x->dbl;
 		}
 	}
 	return defaultValue;
@@ -532,18 +739,10 @@ JsonHandle::stringValue(std::string const &defaultValue) const {
 	if (state == STATE_HAS_NODE) {
 		if (vapor.node->getType() == _JS0::STRING)
 			return vapor.node->stringValue();
-		if (vapor.node->getType() == _JS0::BOOLEAN) {
-			vapor.node->setString(
-					vapor.node->booleanValue() ? "true" : "false");
-			return vapor.node->stringValue();
-		}
-		if (vapor.node->getType() == _JS0::NUMBER_LONG
-				|| vapor.node->getType() == _JS0::NUMBER_DOUBLE) {
-			std::string s;
-			vapor.node->appendStringValue(s, defaultPrecision);
-			vapor.node->setString(s);
-			return vapor.node->stringValue();
-		}
+		if (vapor.node->getType() == _JS0::BOOLEAN)
+			return vapor.node->booleanValue() ? TRUE_STRING : FALSE_STRING;
+		if (vapor.node->isNumber())
+			return vapor.node->numberText(defaultPrecision);
 	}
 	return defaultValue;
 }
@@ -555,24 +754,22 @@ JsonHandle::stringValuePtr(const char *defaultValue) const {
 			const std::string &s = vapor.node->stringValue();
 			return s.c_str();
 		}
-		if (vapor.node->getType() == _JS0::BOOLEAN) {
-			vapor.node->setString(
-					vapor.node->booleanValue() ? "true" : "false");
-			const std::string &s = vapor.node->stringValue();
-			return s.c_str();
-		}
-		if (vapor.node->getType() == _JS0::NUMBER_LONG
-				|| vapor.node->getType() == _JS0::NUMBER_DOUBLE) {
-			std::string st;
-			vapor.node->appendStringValue(st, defaultPrecision);
-			vapor.node->setString(st);
-			const std::string &s = vapor.node->stringValue();
-			return s.c_str();
-		}
+		if (vapor.node->getType() == _JS0::BOOLEAN)
+			return vapor.node->booleanValue() ? "true" : "false";
+		if (vapor.node->isNumber())
+			return vapor.node->numberText(defaultPrecision).c_str();
 	}
 	return defaultValue;
 }
 
+size_t JsonHandle::copyTo(double *values, size_t count) const {
+	return state == STATE_HAS_NODE ? vapor.node->copyTo(values, count) : 0;
+}
+
+size_t JsonHandle::copyTo(int64_t *values, size_t count) const {
+	return state == STATE_HAS_NODE ? vapor.node->copyTo(values, count) : 0;
+}
+
 std::string &
 JsonHandle::toString(std::string &buffer, int precision) const {
 	if (state == STATE_HAS_NODE
@@ -587,10 +784,19 @@ JsonHandle::key(int index) const {
 			vapor.node->getKeyAtIndex(index) : *(std::string*) 0;
 }
 
+bool
+JsonHandle::exists(const char *key) const {
+	return key && state == STATE_HAS_NODE && vapor.node->getByKey(key) != NULL;
+}
+
 bool
 JsonHandle::exists(std::string const &key) const {
-	_JS0 *n = vapor.node->getByKey(key);
-  return n != NULL;
+	return state == STATE_HAS_NODE && vapor.node->getByKey(key) != NULL;
+}
+
+bool
+JsonHandle::exists(const JsonKey &key) const {
+	return state == STATE_HAS_NODE && vapor.node->getByKey(key) != NULL;
 }
 
 std::string &
@@ -603,6 +809,7 @@ JsonHandle::toCompactString(std::string &buffer, int precision) const {
 
 JsonHandle &
 JsonHandle::clear() {
+	unshare();
 	if (state == STATE_HAS_NODE
 	)
 		vapor.node->clear();
@@ -611,6 +818,7 @@ JsonHandle::clear() {
 
 JsonHandle &
 JsonHandle::erase(int index) {
+	unshare();
 	if (state == STATE_HAS_NODE
 	)
 		vapor.node->erase(index);
@@ -619,6 +827,7 @@ JsonHandle::erase(int index) {
 
 JsonHandle &
 JsonHandle::erase(const char *key) {
+	unshare();
 	if (state == STATE_HAS_NODE
 	)
 		vapor.node->erase(key);
@@ -627,6 +836,16 @@ JsonHandle::erase(const char *key) {
 
 JsonHandle &
 JsonHandle::erase(const std::string &key) {
+	unshare();
+	if (state == STATE_HAS_NODE
+	)
+		vapor.node->erase(key);
+	return *this;
+}
+
+JsonHandle &
+JsonHandle::erase(const JsonKey &key) {
+	unshare();
 	if (state == STATE_HAS_NODE
 	)
 		vapor.node->erase(key);
@@ -646,44 +865,166 @@ bool JsonHandle::isString() const {
 	return state == STATE_HAS_NODE && vapor.node->getType() == _JS0::STRING;
 }
 bool JsonHandle::isNumber() const {
-	return state == STATE_HAS_NODE
-			&& (vapor.node->getType() == _JS0::NUMBER_LONG
-					|| vapor.node->getType() == _JS0::NUMBER_DOUBLE);
+	return state == STATE_HAS_NODE && vapor.node->isNumber();
 }
 bool JsonHandle::isBoolean() const {
 	return state == STATE_HAS_NODE && vapor.node->getType() == _JS0::BOOLEAN;
 }
 
-JsonHandle &
-JsonHandle::fromString(const std::string &from) {
-	if (state != STATE_HAS_NODE) {
-		makeVaporNode("fromString()");
-		if (state != STATE_HAS_NODE
-		)
-			return JsonHandle::JSON_ERROR;
+/*
+ * Builds the reader's current value, or its next one, into this handle.
+ * On failure the error is stored when error is not NULL.
+ */
+bool JsonHandle::decode(JsonReader &reader, const JsonProjection *keep,
+		JsonError *error, const char *foo) {
+	JsonError::Code code = JsonError::NONE;
+	unshare();
+	if (state != STATE_HAS_NODE)
+		makeVaporNode(foo);
+	if (state != STATE_HAS_NODE)
+		code = JsonError::INVALID_HANDLE;
+	else {
+		if (!reader.hasValue())
+			reader.next();
+		if (!reader.hasValue())
+			code = (reader.type() == JsonReader::END) ?
+					JsonError::NO_VALUE : reader.errorCode();
+		else if (!vapor.node->setFromReader(reader,
+				(keep == 0 || keep->root->all) ? 0 : keep->root))
+			code = reader.errorCode();
 	}
-	if (!vapor.node->setFromJsonStlString(from)) {
-		return JsonHandle::JSON_ERROR;
+	if (code == JsonError::NONE)
+		return true;
+	if (error) {
+		error->code = code;
+		error->offset = reader.offset();
+		error->depth = reader.depth();
 	}
-	return *this;
+	if (code != JsonError::NO_VALUE && code != JsonError::INVALID_HANDLE)
+		PRINTERR(foo, JsonError::message(code));
+	return false;
+}
 
+JsonHandle &
+JsonHandle::fromReader(JsonReader &reader) {
+	return decode(reader, 0, 0, "fromReader()") ?
+			*this : JsonHandle::JSON_ERROR;
+}
+
+JsonHandle &
+JsonHandle::fromReader(JsonReader &reader, const JsonProjection &keep) {
+	return decode(reader, &keep, 0, "fromReader()") ?
+			*this : JsonHandle::JSON_ERROR;
+}
+
+JsonHandle &
+JsonHandle::fromString(const std::string &from) {
+	JsonError error;
+	return fromString(from, error);
 }
 
 JsonHandle &
 JsonHandle::fromString(const char *from) {
-	if (state != STATE_HAS_NODE) {
-		makeVaporNode("fromString()");
-		if (state != STATE_HAS_NODE
-		)
-			return JsonHandle::JSON_ERROR;
-	}
-	if (from == 0 || !vapor.node->setFromJsonString(from)) {
+	JsonError error;
+	return fromString(from, error);
+}
+
+JsonHandle &
+JsonHandle::fromString(const std::string &from, JsonError &error) {
+	JsonReader reader(from);
+	reader.setOptions(defaultParseOptions);
+	error = JsonError();
+	return decode(reader, 0, &error, "fromString()") ?
+			*this : JsonHandle::JSON_ERROR;
+}
+
+JsonHandle &
+JsonHandle::fromString(const char *from, JsonError &error) {
+	error = JsonError();
+	if (from == 0) {
+		error.code = JsonError::NO_VALUE;
 		return JsonHandle::JSON_ERROR;
 	}
-	return *this;
+	JsonReader reader(from, strlen(from));
+	reader.setOptions(defaultParseOptions);
+	return decode(reader, 0, &error, "fromString()") ?
+			*this : JsonHandle::JSON_ERROR;
+}
+
+JsonHandle &
+JsonHandle::fromString(const std::string &from, const JsonProjection &keep) {
+	JsonReader reader(from);
+	reader.setOptions(defaultParseOptions);
+	return decode(reader, &keep, 0, "fromString()") ?
+			*this : JsonHandle::JSON_ERROR;
+}
+
+JsonHandle &
+JsonHandle::fromString(const char *from, const JsonProjection &keep) {
+	if (from == 0)
+		return JsonHandle::JSON_ERROR;
+	JsonReader reader(from, strlen(from));
+	reader.setOptions(defaultParseOptions);
+	return decode(reader, &keep, 0, "fromString()") ?
+			*this : JsonHandle::JSON_ERROR;
+}
+
+bool JsonHandle::validate(const char *from, size_t length) {
+	JsonError error;
+	return validate(from, length, error);
+}
 
+/*
+ * validate(), minify() and prettify() read with defaultParseOptions and
+ * accept only strict JSON.
+ */
+static void setStrictOptions(JsonReader &reader) {
+	JsonParseOptions options = JsonHandle::defaultParseOptions;
+	options.strict = true;
+	reader.setOptions(options);
 }
 
+bool JsonHandle::validate(const char *from, size_t length, JsonError &error) {
+	JsonReader reader(from, length);
+	setStrictOptions(reader);
+	error = JsonError();
+	if (_JS0::transcode(reader, 0, false, defaultPrecision))
+		return true;
+	error.code = (reader.errorCode() != JsonError::NONE) ?
+			reader.errorCode() : JsonError::NO_VALUE;
+	error.offset = reader.offset();
+	error.depth = reader.depth();
+	return false;
+}
+
+bool JsonHandle::minify(const char *from, size_t length, std::string &to,
+		int precision) {
+	JsonReader reader(from, length);
+	setStrictOptions(reader);
+	return _JS0::transcode(reader, &to, false, precision);
+}
+
+bool JsonHandle::prettify(const char *from, size_t length, std::string &to,
+		int precision) {
+	JsonReader reader(from, length);
+	setStrictOptions(reader);
+	return _JS0::transcode(reader, &to, true, precision);
+}
+
+size_t JsonHandle::reclaim(size_t budget) {
+	return _JS0::reclaim(budget);
+}
+
+#ifdef HAS_JSON_THREADS
+void JsonHandle::startReclaimer() {
+	_JS0::startReclaimer();
+}
+
+void JsonHandle::stopReclaimer() {
+	_JS0::stopReclaimer();
+}
+#endif
+
 void JsonHandle::dumpStats() {
 #ifdef HAS_JSON_STATS
 	fprintf(stderr, "\n+------------------------------+\n");
@@ -703,7 +1044,17 @@ void JsonHandle::dumpStats() {
 
 JsonHandle &
 JsonHandle::fromFile(const char *file) {
+	JsonError error;
+	return fromFile(file, error);
+}
 
+/*
+ * Reads a whole file into a new[] buffer ending with '\0'.
+ * @returns
+ *    the buffer, or NULL with error set.
+ */
+static char *readFile(const char *file, size_t maxBytes, long &length,
+		JsonError &error, const char *foo) {
 #if defined(_MSC_VER) && (_MSC_VER >= 1400 )
 	FILE* fp = 0;
 	if ( fopen_s( &fp, file, "r" ) )
@@ -712,32 +1063,91 @@ JsonHandle::fromFile(const char *file) {
 	FILE *fp = fopen(file, "r");
 #endif
 	if (fp == 0) {
-		PRINTERR("fromFile()", "could not read file");
-		return JsonHandle::JSON_ERROR;
+		PRINTERR(foo, "could not read file");
+		error.code = JsonError::IO_ERROR;
+		return 0;
 	}
-	long length = 0;
+	length = 0;
 	fseek(fp, 0, SEEK_END);
 	length = ftell(fp);
 	fseek(fp, 0, SEEK_SET);
+	if (maxBytes && (unsigned long) length > maxBytes) {
+		error.code = JsonError::TOO_LARGE;
+		PRINTERR(foo, error.message());
+		fclose(fp);
+		return 0;
+	}
 
 	char *buf = new char[length + 1];
 	if (buf == 0) {
 		// could not allocate memory, file too large?
-		PRINTERR("fromFile()", "could not allocate memory");
+		PRINTERR(foo, "could not allocate memory");
+		error.code = JsonError::IO_ERROR;
 		fclose(fp);
-		return JsonHandle::JSON_ERROR;
+		return 0;
 	}
 
 	if (!fread(buf, length, 1, fp)) length = 0;
 	fclose(fp);
 	buf[length] = 0;
+	return buf;
+}
+
+JsonHandle &
+JsonHandle::fromFile(const char *file, JsonError &error) {
+	error = JsonError();
+	long length;
+	char *buf = readFile(file, defaultParseOptions.maxBytes, length, error,
+			"fromFile()");
+	if (buf == 0)
+		return JsonHandle::JSON_ERROR;
 
-	JsonHandle &ret = fromString(buf);
+	JsonHandle &ret = fromString(buf, error);
 
 	delete []buf;
 	return ret;
 }
 
+JsonResult JsonHandle::parse(const char *from, size_t length) {
+	return parse(from, length, defaultParseOptions);
+}
+
+JsonResult JsonHandle::parse(const char *from, size_t length,
+		const JsonParseOptions &options) {
+	JsonReader reader(from, length);
+	reader.setOptions(options);
+	JsonHandle value;
+	JsonError error;
+	if (!value.decode(reader, 0, &error, "parse()"))
+		return JsonResult(error);
+	return JsonResult(error, value);
+}
+
+JsonResult JsonHandle::parse(const std::string &from) {
+	return parse(from.data(), from.length(), defaultParseOptions);
+}
+
+JsonResult JsonHandle::parse(const std::string &from,
+		const JsonParseOptions &options) {
+	return parse(from.data(), from.length(), options);
+}
+
+JsonResult JsonHandle::parseFile(const char *file) {
+	return parseFile(file, defaultParseOptions);
+}
+
+JsonResult JsonHandle::parseFile(const char *file,
+		const JsonParseOptions &options) {
+	JsonError error;
+	long length;
+	char *buf = readFile(file, options.maxBytes, length, error, "parseFile()");
+	if (buf == 0)
+		return JsonResult(error);
+	JsonResult result = parse(buf, length, options);
+	delete []buf;
+	return result;
+}
+
 bool JsonHandle::toFile(const char *file, int precision) const {
 
 #if defined(_MSC_VER) && (_MSC_VER >= 1400 )
@@ -761,20 +1171,23 @@ bool JsonHandle::toFile(const char *file, int precision) const {
 
 std::istream &
 JsonHandle::fromStream(std::istream &stream) {
+	JsonError error;
+	return fromStream(stream, error);
+}
+
+std::istream &
+JsonHandle::fromStream(std::istream &stream, JsonError &error) {
 	if (stream.rdstate() & std::ios_base::failbit)
 		return stream;
-	if (state != STATE_HAS_NODE) {
-		makeVaporNode("fromStream()");
-		if (state != STATE_HAS_NODE
-		) {
-			stream.setstate(stream.rdstate() | std::ios_base::failbit);
-			return stream;
-		}
-	}
-	if (!vapor.node->setFromStream(stream)) {
+	JsonReader reader(stream);
+	reader.setOptions(defaultParseOptions);
+	error = JsonError();
+	bool ok = decode(reader, 0, &error, "fromStream()");
+	// the reader works on the stream buffer, so report its state here
+	if (reader.eof())
+		stream.setstate(stream.rdstate() | std::ios_base::eofbit);
+	if (!ok)
 		stream.setstate(stream.rdstate() | std::ios_base::failbit);
-		return stream;
-	}
 	return stream;
 }
 
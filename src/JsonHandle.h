@@ -28,9 +28,14 @@
 #include <istream>
 #include <ostream>
 #include <string>
+#include <stddef.h>
 #include <stdint.h>
+#include "JsonKey.h"
+#include "JsonReader.h"
+#include "JsonView.h"
 
 class _JS0; // private class to hold actual data
+struct JsonResult;
 
 /**
  * class: JsonHandle
@@ -46,8 +51,15 @@ class _JS0; // private class to hold actual data
  *
  * It is very copy constructor friendly ensuring that the data is
  * not copied when not desired.
+ *
+ * The getters are const but write to the node they read: conversions
+ * between strings and numbers, and numbers read with lazyNumbers, are
+ * cached in it.  They are not safe to call on the same node from several
+ * threads at once, share a document between reader threads as a
+ * JsonFrozen instead.
  */
 class JsonHandle {
+	friend class JsonPath;
 public:
 
 	/**
@@ -70,6 +82,25 @@ public:
 	 */
 	JsonHandle &operator=(const JsonHandle&);
 
+#ifdef JSON_HAS_CXX11
+	/**
+	 * Move Constructor - takes over the reference held by from without
+	 *    counting references.  from is left empty.
+	 */
+	JsonHandle(JsonHandle &&from) {
+		moveFrom(from);
+	}
+
+	/**
+	 * Move assignment - like the assignment operator, but when no other
+	 *    handle or parent shares from's data it is moved instead of
+	 *    cloned.
+	 */
+	JsonHandle &operator=(JsonHandle &&from) {
+		return moveAssign(from);
+	}
+#endif
+
 	/**
 	 * isValid - check to see if handle is usable.  In some cases, it is
 	 *     possible to get an invalid node via.  Usually it will be
@@ -142,16 +173,32 @@ public:
 	 */
 	JsonHandle operator[](std::string const &key);
 
+	/**
+	 * operator[](JsonKey &)
+	 *   same as operator[](char *), comparing hashes before keys.
+	 */
+	JsonHandle operator[](JsonKey const &key);
+
 	/**
 	 * key - returns the object's key at the specified index.  Only
 	 * valid for object types.
 	 */
 	const std::string &key(int index) const;
 
-  /**
-   * exists - checks whether a specific key is present.
-   */
-  bool exists(std::string const &key) const;
+	/**
+	 * exists - checks whether a specific key is present.
+	 */
+	bool exists(const char *key) const;
+
+	/**
+	 * exists - checks whether a specific key is present.
+	 */
+	bool exists(std::string const &key) const;
+
+	/**
+	 * exists - checks whether a specific key is present.
+	 */
+	bool exists(JsonKey const &key) const;
 
 	/**
 	 * size()
@@ -177,6 +224,11 @@ public:
 	 */
 	JsonHandle &erase(const std::string &key);
 
+	/**
+	 * erase -  removes item at specified key.  Valid for objects.
+	 */
+	JsonHandle &erase(JsonKey const &key);
+
 	/**
 	 * clear -  removes all items.  Valid for objects and arrays.
 	 *    passive otherwise.
@@ -198,12 +250,17 @@ public:
 	 */
 	JsonHandle at(std::string const &key);
 
+	/**
+	 * at(JsonKey &) - Same as operator[JsonKey &]
+	 */
+	JsonHandle at(JsonKey const &key);
+
 	// convenient cast operators
 	 operator int64_t () const {
 		return longValue();
 	}
 	operator uint64_t() const {
-		return (uint64_t) longValue();
+		return ulongValue();
 	}
 	operator int() const {
 		return (int) longValue();
@@ -229,6 +286,46 @@ public:
 	operator const std::string &() const {
 		return stringValue();
 	}
+	operator JsonView() const {
+		return view();
+	}
+
+	/**
+	 * view - a read only JsonView of the current data, for lookups that
+	 *    do not allocate or count references.  The view is undefined when
+	 *    the handle has no data.
+	 */
+	JsonView view() const {
+		return JsonView(state == 1 ? vapor.node : 0);
+	}
+
+	/**
+	 * begin, end - iterators over the values of an array or object, see
+	 *    JsonView::iterator.  Changing the array or object invalidates
+	 *    them.
+	 */
+	JsonView::iterator begin() const {
+		return view().begin();
+	}
+
+	JsonView::iterator end() const {
+		return view().end();
+	}
+
+	/**
+	 * items - the key and value pairs of an object, see JsonView::items().
+	 */
+	JsonView::item_range items() const {
+		return view().items();
+	}
+
+	/**
+	 * extract - looks up all the keys of an object in one pass, see
+	 *   JsonView::extract().
+	 */
+	int extract(const JsonKeySet &keys, JsonView values[]) const {
+		return view().extract(keys, values);
+	}
 
 	/**
 	 * operatpr=(bool) same as setBoolean()
@@ -244,6 +341,13 @@ public:
 		return setLong(value);
 	}
 
+	/**
+	 * operatpr=(uint64_t) same as setULong()
+	 */
+	JsonHandle &operator=(uint64_t value) {
+		return setULong(value);
+	}
+
 	/**
 	 * operatpr=(int) same as setLong()
 	 */
@@ -279,6 +383,15 @@ public:
 		return setString(value);
 	}
 
+#ifdef JSON_HAS_CXX11
+	/**
+	 * operatpr=(string &&) same as setString(string &&)
+	 */
+	JsonHandle &operator=(std::string &&value) {
+		return takeString(value);
+	}
+#endif
+
 	/**
 	 * operatpr=(char *) same as setString(char *)
 	 */
@@ -298,6 +411,12 @@ public:
 	 */
 	JsonHandle &setLong(int64_t value);
 
+	/**
+	 * setULong: set the current handle to uint64_t
+	 *   value, for values above INT64_MAX.
+	 */
+	JsonHandle &setULong(uint64_t value);
+
 	/**
 	 * setDouble: set the current handle to long double
 	 *   value.
@@ -316,29 +435,63 @@ public:
 	 */
 	JsonHandle &setString(const char *value);
 
+#ifdef JSON_HAS_CXX11
+	/**
+	 * setString: set the current handle to string
+	 *   value, taking over its buffer instead of copying it.
+	 */
+	JsonHandle &setString(std::string &&value) {
+		return takeString(value);
+	}
+#endif
+
+	/**
+	 * assign: set the current handle to an array of count
+	 *   doubles, kept packed without a node each.
+	 */
+	JsonHandle &assign(const double *values, size_t count);
+
+	/**
+	 * assign: set the current handle to an array of count
+	 *   integers, kept packed without a node each.
+	 */
+	JsonHandle &assign(const int64_t *values, size_t count);
+
 	/**
 	 * booleanValue: gets the boolean value.
-	 *   If the current type is string,
-	 *   the type will change to boolean,
+	 *   If the current type is string it is converted,
 	 *   looking for true, false, yes, no, on, off.
+	 *   The conversion is kept, the type does not change.
 	 * @returns
 	 *   value or defaultValue if not set or conversion failed.
 	 */
 	bool booleanValue(bool defaultValue = false) const;
 
 	/**
-	 * longValue: gets the long value.
-	 *   If the current type is string,
-	 *   the type will change to number,
+	 * longValue: gets the long value.  Numbers out of range
+	 *   are clamped.
+	 *   If the current type is string it is converted.
+	 *   The conversion is kept, the type does not change.
 	 * @returns
 	 *   value or defaultValue if not set or conversion failed.
 	 */
 	int64_t longValue(int64_t defaultValue = 0) const;
 
+	/**
+	 * ulongValue: gets the unsigned long value, for values
+	 *   up to 18446744073709551615.  Numbers out of range,
+	 *   negative ones included, are clamped.
+	 *   If the current type is string it is converted.
+	 *   The conversion is kept, the type does not change.
+	 * @returns
+	 *   value or defaultValue if not set or conversion failed.
+	 */
+	uint64_t ulongValue(uint64_t defaultValue = 0) const;
+
 	/**
 	 * doubleValue: gets the double value.
-	 *   If the current type is string,
-	 *   the type will change to number,
+	 *   If the current type is string it is converted.
+	 *   The conversion is kept, the type does not change.
 	 * @returns
 	 *   value or defaultValue if not set or conversion failed.
 	 */
@@ -346,8 +499,8 @@ public:
 
 	/**
 	 * stringValue: gets the string value.
-	 *   If the current type is boolean
-	 *   or number type will change to string,
+	 *   If the current type is boolean or number it is converted.
+	 *   The conversion is kept, the type does not change.
 	 * @returns
 	 *   value or defaultValue if not set or conversion failed.
 	 */
@@ -356,19 +509,49 @@ public:
 
 	/**
 	 * stringValuePtr: gets the string value.
-	 *   If the current type is boolean
-	 *   or number type will change to string,
+	 *   If the current type is boolean or number it is converted.
+	 *   The conversion is kept, the type does not change.
 	 * @returns
 	 *   value or defaultValue if not set or conversion failed.
 	 */
 	const char *stringValuePtr(const char *defaultValue = NULL) const;
 
+	/**
+	 * copyTo: copies the first count members of an array as
+	 *   doubles.  A packed array is read without making nodes,
+	 *   members that are not numbers or booleans give 0.
+	 * @returns
+	 *   the number copied, fewer when the array is shorter.
+	 */
+	size_t copyTo(double *values, size_t count) const;
+
+	/**
+	 * copyTo: copies the first count members of an array as
+	 *   integers, clamped as by longValue().
+	 * @returns
+	 *   the number copied, fewer when the array is shorter.
+	 */
+	size_t copyTo(int64_t *values, size_t count) const;
+
 	/**
 	 * copy: deep copies the contents one node to another.  Existing
 	 *   contents will be released.
 	 */
 	JsonHandle &copy(const JsonHandle &from);
 
+#ifdef JSON_HAS_CXX11
+	/**
+	 * adopt: moves the contents of from here without cloning them.  When
+	 *   from is a member of an array or object it is removed from there,
+	 *   so a subtree can be moved to a new parent.  Other handles to the
+	 *   moved data see it undefined.  from must not contain this handle's
+	 *   data.
+	 */
+	JsonHandle &adopt(JsonHandle &&from) {
+		return adoptFrom(from);
+	}
+#endif
+
 	/**
 	 * fromString: appends the current contents with data decoded
 	 *   from the provided string.
@@ -381,12 +564,62 @@ public:
 	 */
 	JsonHandle &fromString(const char *from);
 
+	/**
+	 * fromString: appends the current contents with data decoded
+	 *   from the provided string.  On failure the reason is stored in
+	 *   error, see JsonError.
+	 */
+	JsonHandle &fromString(const std::string &from, JsonError &error);
+
+	/**
+	 * fromString: appends the current contents with data decoded
+	 *   from the provided string.  On failure the reason is stored in
+	 *   error, see JsonError.
+	 */
+	JsonHandle &fromString(const char *from, JsonError &error);
+
+	/**
+	 * fromString: appends the current contents with the parts of the
+	 *   provided string that are selected by the projection.  Everything
+	 *   else is skipped without being decoded.
+	 */
+	JsonHandle &fromString(const std::string &from,
+			const JsonProjection &keep);
+
+	/**
+	 * fromString: appends the current contents with the parts of the
+	 *   provided string that are selected by the projection.  Everything
+	 *   else is skipped without being decoded.
+	 */
+	JsonHandle &fromString(const char *from, const JsonProjection &keep);
+
+	/**
+	 * fromReader: appends the current contents with the value the reader
+	 *   is positioned on, or with the next value if the current one was
+	 *   already passed.  The reader's limits are enforced while the value
+	 *   is built, see JsonParseOptions.
+	 */
+	JsonHandle &fromReader(JsonReader &reader);
+
+	/**
+	 * fromReader: appends the current contents with the parts of the
+	 *   reader's next value that are selected by the projection.
+	 */
+	JsonHandle &fromReader(JsonReader &reader, const JsonProjection &keep);
+
 	/**
 	 * fromString: appends the current contents with data decoded
 	 *   from the provided file.
 	 */
 	JsonHandle &fromFile(const char *file);
 
+	/**
+	 * fromFile: appends the current contents with data decoded
+	 *   from the provided file.  On failure the reason is stored in
+	 *   error, see JsonError.
+	 */
+	JsonHandle &fromFile(const char *file, JsonError &error);
+
 	/**
 	 * toString: JSON encodes the contents into the provided string buffer
 	 *   WITH whitespace.  See also  toCompactString().
@@ -419,6 +652,12 @@ public:
 	 *   be pulled from the stream allowing other data to exist.
 	 */
 	std::istream &fromStream(std::istream &stream);
+
+	/**
+	 * fromStream - as above, also storing the reason of a failure in
+	 *   error, see JsonError.
+	 */
+	std::istream &fromStream(std::istream &stream, JsonError &error);
 	friend std::istream &operator>>(std::istream &stream, JsonHandle &ob);
 
 	/**
@@ -428,12 +667,153 @@ public:
 	std::ostream &toStream(std::ostream &stream);
 	friend std::ostream &operator<<(std::ostream &stream, JsonHandle ob);
 
+	/**
+	 * parse - decodes the buffer into a new handle.  Unlike fromString()
+	 *   nothing shared is returned on failure, so threads can decode at
+	 *   the same time without touching common data.
+	 * @returns
+	 *   the value, or an undefined one and the reason it failed.
+	 */
+	static JsonResult parse(const char *from, size_t length);
+
+	/**
+	 * parse - as above, with options in place of defaultParseOptions.
+	 */
+	static JsonResult parse(const char *from, size_t length,
+			const JsonParseOptions &options);
+
+	/**
+	 * parse - decodes the string into a new handle, see above.
+	 */
+	static JsonResult parse(const std::string &from);
+
+	/**
+	 * parse - as above, with options in place of defaultParseOptions.
+	 */
+	static JsonResult parse(const std::string &from,
+			const JsonParseOptions &options);
+
+	/**
+	 * parseFile - decodes the file into a new handle, see parse().
+	 */
+	static JsonResult parseFile(const char *file);
+
+	/**
+	 * parseFile - as above, with options in place of defaultParseOptions.
+	 */
+	static JsonResult parseFile(const char *file,
+			const JsonParseOptions &options);
+
+	/**
+	 * validate - checks that the buffer holds exactly one well formed JSON
+	 *   value, surrounded by optional whitespace, without building a tree.
+	 *   The buffer is read with defaultParseOptions and strictly, so
+	 *   input fromString() tolerates, such as [1,], is rejected.
+	 */
+	static bool validate(const char *from, size_t length);
+
+	/**
+	 * validate - as above, also storing the reason of a failure in error.
+	 */
+	static bool validate(const char *from, size_t length, JsonError &error);
+
+	/**
+	 * minify - re-encodes the buffer WITHOUT whitespace, appending to the
+	 *   provided string.  The output is the same as fromString() followed
+	 *   by toCompactString() but no tree is built.  The buffer is read as by
+	 *   validate().
+	 * @returns
+	 *   false if the buffer is not valid, see validate().
+	 */
+	static bool minify(const char *from, size_t length, std::string &to,
+			int precision = defaultPrecision);
+
+	/**
+	 * prettify - re-encodes the buffer WITH whitespace, appending to the
+	 *   provided string.  The output is the same as fromString() followed
+	 *   by toString() but no tree is built.  The buffer is read as by
+	 *   validate().
+	 * @returns
+	 *   false if the buffer is not valid, see validate().
+	 */
+	static bool prettify(const char *from, size_t length, std::string &to,
+			int precision = defaultPrecision);
+
 	/**
 	 * In the cases where precision is not provided, this is the default precision
 	 * for double conversions.
 	 */
 	static int defaultPrecision;
 
+	/**
+	 * When set, the assignment operator and copy() share the arrays and
+	 * objects inside the source instead of cloning them.  A shared part
+	 * is copied the first time it is reached through operator[] or at()
+	 * to be changed, so copying a large document and editing a few
+	 * fields only copies the nodes on the edited paths.  Read through a
+	 * JsonView to avoid copying.  Handles taken into a document's nested
+	 * values before the document was copied still change the shared
+	 * data, take them again after copying.  Off by default.
+	 */
+	static bool copyOnWrite;
+
+	/**
+	 * When set, releasing the last reference to a non-empty array or
+	 * object only queues it, and reclaim() or the reclaimer thread frees
+	 * it and everything below it later.  Dropping a large document then
+	 * costs the releasing thread no more than a small one.  Queued
+	 * documents are not freed until reclaim() is called.  Off by default.
+	 */
+	static bool deferredFree;
+
+	/**
+	 * reclaim - frees what deferredFree queued, visiting at most budget
+	 *   nodes so a large document can be freed in slices, for example
+	 *   between requests.  Call it from the thread that owns the
+	 *   documents, or from any thread with HAS_JSON_THREADS.
+	 * @returns
+	 *   the number of arrays and objects still queued.
+	 */
+	static size_t reclaim(size_t budget = (size_t) -1);
+
+#ifdef HAS_JSON_THREADS
+	/**
+	 * startReclaimer - starts a thread that frees what deferredFree
+	 *   queues as soon as it is queued.
+	 */
+	static void startReclaimer();
+
+	/**
+	 * stopReclaimer - stops the reclaimer thread once it has freed what
+	 *   is queued.  Call it before exit.
+	 */
+	static void stopReclaimer();
+#endif
+
+	/**
+	 * Limits used by fromString(), fromFile() and fromStream().  By default
+	 * nothing is limited.
+	 */
+	static JsonParseOptions defaultParseOptions;
+
+	/**
+	 * ErrorFunction - receives the name of the failing function and a
+	 *   description of the error.
+	 */
+	typedef void (*ErrorFunction)(const char *function, const char *message);
+
+	/**
+	 * Called with every error when set.  It is NULL by default so errors
+	 * cost nothing beyond the JSON_ERROR return.  Set it to printError to
+	 * get the messages on stderr.
+	 */
+	static ErrorFunction errorFunction;
+
+	/**
+	 * printError - an ErrorFunction that prints to stderr.
+	 */
+	static void printError(const char *function, const char *message);
+
 	/**
 	 * EMPTY_STRING - handy item used for dealing with empty strings without allocation.
 	 */
@@ -468,7 +848,15 @@ protected:
 	JsonHandle(_JS0 *parent, const std::string &key);
 	JsonHandle(_JS0 *parent, const char *key);
 	JsonHandle(_JS0 *parent, int index);
+	JsonHandle(_JS0 *parent, const JsonKey &key);
 	void makeVaporNode(const char *foo);
+	void unshare();
+	void moveFrom(JsonHandle &from);
+	JsonHandle &moveAssign(JsonHandle &from);
+	JsonHandle &adoptFrom(JsonHandle &from);
+	JsonHandle &takeString(std::string &value);
+	bool decode(JsonReader &reader, const JsonProjection *keep,
+			JsonError *error, const char *foo);
 
 	_JS0 *parent;
 	int state;
@@ -476,6 +864,7 @@ protected:
 		union {
 			_JS0 *node;
 			const std::string *stlkey;
+			const JsonKey *jsonkey;
 			const char *key;
 			int index;
 		};
@@ -490,4 +879,36 @@ inline std::istream &operator>>(std::istream &stream, JsonHandle &ob) {
 	return ob.fromStream(stream);
 }
 
+/**
+ * struct: JsonResult
+ *
+ * What JsonHandle::parse() and parseFile() return, owned by the caller.
+ * Copying it refers to the same data, as with a JsonHandle.
+ *
+ * For example:
+ *    JsonResult r = JsonHandle::parse(buffer, length);
+ *    if (!r.ok())
+ *       reject(r.error.message(), r.error.offset);
+ *    process(r.value);
+ */
+struct JsonResult {
+	JsonError error;
+	JsonHandle value;
+
+	JsonResult() {
+	}
+
+	explicit JsonResult(const JsonError &error) :
+			error(error) {
+	}
+
+	JsonResult(const JsonError &error, const JsonHandle &value) :
+			error(error), value(value) {
+	}
+
+	bool ok() const {
+		return error.code == JsonError::NONE;
+	}
+};
+
 #endif /* __JSONHANDLE_H__ */
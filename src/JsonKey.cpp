@@ -0,0 +1,73 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "JsonKey.h"
+#include <string>
+#include <vector>
+
+JsonKeySet::JsonKeySet() {
+}
+
+JsonKeySet::JsonKeySet(const char * const keys[], int count) {
+	for (int i = 0; i < count; i++)
+		add(keys[i]);
+}
+
+JsonKeySet &JsonKeySet::add(const char *key) {
+	return add(std::string(key ? key : ""));
+}
+
+JsonKeySet &JsonKeySet::add(const JsonKey &key) {
+	return add(std::string(key.data(), key.length()));
+}
+
+JsonKeySet &JsonKeySet::add(const std::string &key) {
+	keys.push_back(key);
+	hashes.push_back(JsonKey::hash(key.data(), key.length()));
+
+	// keep the table at most half full so probes stay short
+	if (keys.size() * 2 > table.size()) {
+		table.assign(table.empty() ? 16 : table.size() * 2, 0);
+		for (size_t i = 0; i < keys.size(); i++)
+			insert(i);
+	} else
+		insert(keys.size() - 1);
+	return *this;
+}
+
+/*
+ * Places keys[index] in the first free slot after its hash.  A key
+ * already in the table keeps its place, so find() returns the first.
+ */
+void JsonKeySet::insert(int index) {
+	size_t mask = table.size() - 1;
+	const std::string &k = keys[index];
+	if (find(k.data(), k.length(), hashes[index]) >= 0)
+		return;
+	size_t i = hashes[index] & mask;
+	while (table[i])
+		i = (i + 1) & mask;
+	table[i] = index + 1;
+}
@@ -0,0 +1,229 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __JSONKEY_H__
+#define __JSONKEY_H__
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// set when the compiler supports C++11, features that need it are left out
+#if !defined(JSON_HAS_CXX11) \
+		&& (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900))
+#define JSON_HAS_CXX11
+#endif
+
+// and C++17, needed by JsonBind.h
+#if !defined(JSON_HAS_CXX17) && (__cplusplus >= 201703L \
+		|| (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#define JSON_HAS_CXX17
+#endif
+
+#ifdef JSON_HAS_CXX11
+#define JSON_CONSTEXPR constexpr
+#else
+#define JSON_CONSTEXPR
+#endif
+
+/**
+ * class: JsonKey
+ *
+ * An object key with its length and hash worked out in advance.  Lookups
+ * with a JsonKey reject members by hash and length before comparing any
+ * bytes.  With C++11 a key made from a string literal is built at
+ * compile time, so nothing is hashed at run time.
+ *
+ * For example:
+ *    static JSON_CONSTEXPR JsonKey NAME("name");
+ *    const char *name = root[NAME].stringValuePtr();
+ *
+ * A JsonKey points at the characters it was made from, they must outlive
+ * it.
+ */
+class JsonKey {
+public:
+
+	/**
+	 * Constructor - from a string literal or array.  The key ends at the
+	 *   first '\0'.
+	 */
+	template<size_t N>
+	JSON_CONSTEXPR JsonKey(const char (&key)[N]) :
+			str(key), len(lengthOf(key, N - 1, 0)), h(
+					hashOf(key, lengthOf(key, N - 1, 0), 2166136261u)) {
+	}
+
+	/**
+	 * Constructor - from characters that are not a literal, such as the
+	 *   contents of a std::string.
+	 */
+	JsonKey(const char *key, size_t length) :
+			str(key), len(length), h(hash(key, length)) {
+	}
+
+	JSON_CONSTEXPR const char *data() const {
+		return str;
+	}
+
+	JSON_CONSTEXPR size_t length() const {
+		return len;
+	}
+
+	JSON_CONSTEXPR uint32_t hashValue() const {
+		return h;
+	}
+
+	/**
+	 * hash - the FNV-1a hash used for keys in objects.
+	 */
+	static uint32_t hash(const char *key, size_t length) {
+		uint32_t h = 2166136261u;
+		for (size_t i = 0; i < length; i++)
+			h = (h ^ (unsigned char) key[i]) * 16777619u;
+		return h;
+	}
+
+private:
+	// the same as strlen() and hash(), in a form C++11 can run at compile time
+	static JSON_CONSTEXPR size_t lengthOf(const char *key, size_t max,
+			size_t i) {
+		return (i == max || key[i] == 0) ? i : lengthOf(key, max, i + 1);
+	}
+
+	static JSON_CONSTEXPR uint32_t hashOf(const char *key, size_t length,
+			uint32_t h) {
+		return length == 0 ?
+				h :
+				hashOf(key + 1, length - 1,
+						(h ^ (unsigned char) *key) * 16777619u);
+	}
+
+	const char *str;
+	size_t len;
+	uint32_t h;
+};
+
+/**
+ * class: JsonKeySet
+ *
+ * A fixed list of keys to look up together.  The keys are hashed into a
+ * small table when they are added, so finding which of them a member's
+ * key is takes one probe instead of a comparison per key.
+ * JsonView::extract() fills the values of all the keys in one pass over
+ * an object and JsonReader::nextKey() does the same over raw input.
+ *
+ * For example:
+ *    enum { ID, NAME, TS };
+ *    static const JsonKeySet fields = JsonKeySet().add("id").add("name")
+ *          .add("ts");
+ *    JsonView v[3];
+ *    root.extract(fields, v);
+ *    msg.id = v[ID].longValue();
+ *
+ * Keys are numbered in the order they were added.  A key added twice is
+ * only found at its first index.
+ */
+class JsonKeySet {
+public:
+
+	/**
+	 * Constructor - creates an empty set.
+	 */
+	JsonKeySet();
+
+	/**
+	 * Constructor - adds count keys from an array.
+	 */
+	JsonKeySet(const char * const keys[], int count);
+
+	/**
+	 * add - appends a key to the set.
+	 */
+	JsonKeySet &add(const char *key);
+
+	/**
+	 * add - appends a key to the set.
+	 */
+	JsonKeySet &add(const std::string &key);
+
+	/**
+	 * add - appends a key to the set.
+	 */
+	JsonKeySet &add(const JsonKey &key);
+
+	/**
+	 * size - the number of keys.
+	 */
+	int size() const {
+		return (int) keys.size();
+	}
+
+	/**
+	 * key - returns the key at index.
+	 */
+	const std::string &key(int index) const {
+		return keys[index];
+	}
+
+	/**
+	 * find - looks up a key whose hash is already known.
+	 * @returns
+	 *    the index of the key or -1 when it is not in the set.
+	 */
+	int find(const char *key, size_t length, uint32_t hash) const {
+		if (table.empty())
+			return -1;
+		size_t mask = table.size() - 1;
+		for (size_t i = hash & mask;; i = (i + 1) & mask) {
+			int index = table[i] - 1;
+			if (index < 0)
+				return -1;
+			const std::string &k = keys[index];
+			if (hashes[index] == hash && k.length() == length
+					&& k.compare(0, length, key, length) == 0)
+				return index;
+		}
+	}
+
+	/**
+	 * find - looks up a key.
+	 * @returns
+	 *    the index of the key or -1 when it is not in the set.
+	 */
+	int find(const std::string &key) const {
+		return find(key.data(), key.length(),
+				JsonKey::hash(key.data(), key.length()));
+	}
+
+private:
+	void insert(int index);
+
+	std::vector<std::string> keys;
+	std::vector<uint32_t> hashes;
+	std::vector<int> table; // index + 1 of a key, 0 when empty
+};
+
+#endif /* __JSONKEY_H__ */
@@ -0,0 +1,222 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "JsonPath.h"
+#include "_JS0.h"
+#include <string>
+#include <vector>
+
+JsonPath::JsonPath(const char *path) :
+		valid(true) {
+	parse(std::string(path ? path : ""));
+}
+
+JsonPath::JsonPath(const std::string &path) :
+		valid(true) {
+	parse(path);
+}
+
+void JsonPath::parse(const std::string &path) {
+	size_t n = path.length();
+	if (n == 0)
+		return;
+	if (path[0] == '/') {
+		// JSON Pointer
+		std::string key;
+		for (size_t i = 1; i <= n; i++) {
+			if (i == n || path[i] == '/') {
+				addSegment(key, false);
+				key.clear();
+			} else if (path[i] == '~') {
+				if (i + 1 < n && (path[i + 1] == '0' || path[i + 1] == '1')) {
+					key.push_back(path[++i] == '0' ? '~' : '/');
+				} else {
+					valid = false;
+					return;
+				}
+			} else
+				key.push_back(path[i]);
+		}
+		return;
+	}
+	size_t i = 0;
+	while (1) {
+		size_t e = i;
+		while (e < n && path[e] != '.' && path[e] != '[')
+			e++;
+		if (e > i || e == n || path[e] == '.')
+			addSegment(path.substr(i, e - i), false);
+		while (e < n && path[e] == '[') {
+			size_t c = path.find(']', e);
+			if (c == std::string::npos || c == e + 1) {
+				valid = false;
+				return;
+			}
+			for (size_t k = e + 1; k < c; k++) {
+				if (path[k] < '0' || path[k] > '9') {
+					valid = false;
+					return;
+				}
+			}
+			addSegment(path.substr(e + 1, c - e - 1), true);
+			e = c + 1;
+		}
+		if (e == n)
+			break;
+		if (path[e] != '.') {
+			valid = false;
+			return;
+		}
+		i = e + 1;
+	}
+}
+
+void JsonPath::addSegment(const std::string &key, bool indexOnly) {
+	segment seg;
+	seg.key = key;
+	seg.hash = JsonKey::hash(key.data(), key.length());
+	seg.index = -1;
+	seg.indexOnly = indexOnly;
+	seg.slot = 0;
+	if (key == "-") {
+		seg.index = -2;
+	} else if (!key.empty() && key.length() <= 9
+			&& (indexOnly || key[0] != '0' || key.length() == 1)) {
+		int index = 0;
+		size_t i = 0;
+		for (; i < key.length() && key[i] >= '0' && key[i] <= '9'; i++)
+			index = index * 10 + (key[i] - '0');
+		if (i == key.length())
+			seg.index = index;
+	}
+	if (indexOnly && seg.index < 0)
+		valid = false;
+	segments.push_back(seg);
+}
+
+/*
+ * Looks up one segment.  Object members are checked at the remembered
+ * slot first and otherwise scanned from the end, like getByKey(),
+ * comparing hashes before keys.
+ */
+_JS0 *
+JsonPath::find(const _JS0 *node, const segment &seg) {
+	if (node->type == _JS0::ARRAY) {
+		if (node->packed) // see get() and make()
+			return 0;
+		if (seg.index >= 0 && seg.index < (int) node->value.arr->size())
+			return (*node->value.arr)[seg.index];
+		return 0;
+	}
+	if (node->type != _JS0::OBJECT || seg.indexOnly)
+		return 0;
+	const std::vector<_JS0::entry *> &obj = *node->value.obj;
+	int n = obj.size();
+	if (seg.slot < n) {
+		const _JS0::entry *e = obj[seg.slot];
+		if (e->hash == seg.hash && e->key == seg.key)
+			return e->node;
+	}
+	for (int i = n - 1; i >= 0; i--) {
+		const _JS0::entry *e = obj[i];
+		if (e->hash == seg.hash && e->key == seg.key) {
+			seg.slot = i;
+			return e->node;
+		}
+	}
+	return 0;
+}
+
+JsonView JsonPath::get(JsonView root) const {
+	const _JS0 *node = root.node();
+	if (!valid)
+		return JsonView();
+	for (size_t i = 0; node && i < segments.size(); i++) {
+		// the members of a packed array are numbers read in place
+		if (node->packed) {
+			int index = segments[i].index;
+			if (i + 1 == segments.size() && index >= 0
+					&& index < node->length())
+				return JsonView(node, index);
+			return JsonView();
+		}
+		node = find(node, segments[i]);
+	}
+	return JsonView(node);
+}
+
+// tests if a missing value at index is appended to an array in node
+bool JsonPath::appendsTo(const _JS0 *node, int index) {
+	return node->type == _JS0::ARRAY
+			|| (node->type != _JS0::OBJECT && index != -1);
+}
+
+JsonHandle JsonPath::make(JsonHandle &root) const {
+	if (!valid)
+		return JsonHandle::JSON_ERROR;
+	root.unshare();
+	if (!root.isDefined())
+		root.makeVaporNode("make()");
+	if (!root.isDefined())
+		return JsonHandle::JSON_ERROR;
+
+	// walk what exists, taking copies of what is shared
+	_JS0 *node = root.vapor.node;
+	_JS0 *parent = 0;
+	size_t i = 0;
+	for (; i < segments.size(); i++) {
+		if (node->packed)
+			node->unpack();
+		_JS0 *child = node->own(find(node, segments[i]));
+		if (!child)
+			break;
+		parent = node;
+		node = child;
+	}
+
+	// check the rest can be created before changing anything
+	for (size_t k = i; k < segments.size(); k++) {
+		const segment &seg = segments[k];
+		if (k == i ? appendsTo(node, seg.index) : seg.index != -1) {
+			int size = (k == i) ? node->length() : 0;
+			if (seg.index != -2 && seg.index != size)
+				return JsonHandle::JSON_ERROR;
+		} else if (seg.indexOnly)
+			return JsonHandle::JSON_ERROR;
+	}
+
+	for (; i < segments.size(); i++) {
+		_JS0 *child = new _JS0();
+		if (appendsTo(node, segments[i].index))
+			node->setByIndex(node->type == _JS0::ARRAY ? node->length() : 0,
+					child);
+		else
+			node->setByKey(segments[i].key, child);
+		parent = node;
+		node = child;
+	}
+	if (node->type == _JS0::UNDEFINED)
+		node->setNull();
+	return JsonHandle(node, parent);
+}
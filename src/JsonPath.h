@@ -0,0 +1,131 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __JSONPATH_H__
+#define __JSONPATH_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "JsonHandle.h"
+#include "JsonView.h"
+
+/**
+ * class: JsonPath
+ *
+ * A path into a tree that is parsed once and evaluated many times.  Two
+ * syntaxes are accepted:
+ *    "/meta/source/host"    RFC 6901 JSON Pointer, ~0 is '~' and ~1 is '/'
+ *    "meta.source.host"     keys separated by '.', as in JsonProjection
+ *    "items[3].id"          [n] or a plain number selects an array index
+ *
+ * Each key is hashed when the path is built.  When looking a key up the
+ * path first tries the object member it found last time, so messages
+ * with the same layout are resolved without scanning their objects.
+ *
+ * For example, a path kept by the object that handles the messages:
+ *    struct Handler {
+ *       JsonPath host;
+ *       Handler() : host("meta.source.host") {}
+ *       void handle(JsonView message, JsonHandle &reply) {
+ *          const char *h = host.get(message).stringValuePtr();
+ *          host.make(reply) = "localhost";
+ *       }
+ *    };
+ *
+ * The remembered positions are kept in the path and updated by get() and
+ * make() even though they are const, so a path must not be shared
+ * between threads.  Give each thread its own, not a static one.
+ */
+class JsonPath {
+public:
+
+	/**
+	 * Constructor - parses path.  An empty path refers to the root.
+	 */
+	JsonPath(const char *path);
+
+	/**
+	 * Constructor - parses path.  An empty path refers to the root.
+	 */
+	JsonPath(const std::string &path);
+
+	/**
+	 * isValid - tests if the path could be parsed.  An invalid path
+	 *    finds nothing.
+	 */
+	bool isValid() const {
+		return valid;
+	}
+
+	/**
+	 * size - the number of segments.
+	 */
+	int size() const {
+		return (int) segments.size();
+	}
+
+	/**
+	 * get - finds the value at the path.
+	 * @returns
+	 *   the value, or an undefined view when it does not exist.
+	 */
+	JsonView get(JsonView root) const;
+
+	/**
+	 * exists - tests if there is a value at the path.
+	 */
+	bool exists(JsonView root) const {
+		return get(root).isDefined();
+	}
+
+	/**
+	 * make - finds the value at the path, creating the objects, arrays and
+	 *   the value itself (as null) when missing, so it can be assigned.
+	 *   An array can only grow by its next index, or "-" in a pointer.
+	 * @returns
+	 *   handle to the value or JsonHandle::JSON_ERROR when the path
+	 *   cannot be created.
+	 */
+	JsonHandle make(JsonHandle &root) const;
+
+private:
+	struct segment {
+		std::string key;
+		uint32_t hash;
+		int index; // -1 when key is not a number, -2 for "-"
+		bool indexOnly; // written as [n]
+		mutable int slot; // member matched last time
+	};
+
+	void parse(const std::string &path);
+	void addSegment(const std::string &key, bool indexOnly);
+	static _JS0 *find(const _JS0 *node, const segment &seg);
+	static bool appendsTo(const _JS0 *node, int index);
+
+	std::vector<segment> segments;
+	bool valid;
+};
+
+#endif /* __JSONPATH_H__ */
@@ -0,0 +1,210 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "JsonPublished.h"
+
+#ifdef JSON_HAS_CXX11
+
+#include "JsonHandle.h"
+#include <algorithm>
+#include <vector>
+
+/*
+ * A hazard slot names the version one snapshot reads, so writers do not
+ * free it.  The slots are in one list shared by every JsonPublished and
+ * are never freed.  A thread keeps the slots it gave back for its next
+ * snapshots, so reading only writes to memory of its own.
+ */
+struct JsonPublished::hazard {
+	std::atomic<const JsonFrozen *> pointer;
+	std::atomic<bool> taken;
+	hazard *next;
+	char padding[40]; // a cache line each, readers do not share them
+
+	hazard() :
+			pointer(0), taken(true), next(0) {
+	}
+
+	// the slots a thread keeps, given back to the list when it ends
+	struct cache {
+		hazard *slots[4];
+		int count;
+
+		cache() :
+				count(0) {
+		}
+
+		~cache() {
+			while (count > 0)
+				slots[--count]->taken.store(false, std::memory_order_release);
+		}
+	};
+
+	static cache &local() {
+		static thread_local cache c;
+		return c;
+	}
+
+	static hazard *acquire();
+	static void release(hazard *h);
+
+	static std::atomic<hazard *> list;
+};
+
+std::atomic<JsonPublished::hazard *> JsonPublished::hazard::list(0);
+
+JsonPublished::hazard *
+JsonPublished::hazard::acquire() {
+	cache &c = local();
+	if (c.count > 0)
+		return c.slots[--c.count];
+	for (hazard *h = list.load(std::memory_order_acquire); h; h = h->next) {
+		bool expected = false;
+		if (!h->taken.load(std::memory_order_relaxed)
+				&& h->taken.compare_exchange_strong(expected, true,
+						std::memory_order_acquire))
+			return h;
+	}
+	hazard *h = new hazard();
+	h->next = list.load(std::memory_order_relaxed);
+	while (!list.compare_exchange_weak(h->next, h, std::memory_order_release,
+			std::memory_order_relaxed))
+		;
+	return h;
+}
+
+void JsonPublished::hazard::release(hazard *h) {
+	h->pointer.store(0, std::memory_order_release);
+	cache &c = local();
+	if (c.count < 4)
+		c.slots[c.count++] = h;
+	else
+		h->taken.store(false, std::memory_order_release);
+}
+
+JsonPublished::snapshot::~snapshot() {
+	if (slot)
+		hazard::release(slot);
+}
+
+JsonPublished::snapshot &JsonPublished::snapshot::operator=(snapshot &&other) {
+	if (this != &other) {
+		if (slot)
+			hazard::release(slot);
+		slot = other.slot;
+		document = other.document;
+		other.slot = 0;
+		other.document = 0;
+	}
+	return *this;
+}
+
+JsonPublished::~JsonPublished() {
+	delete current.load();
+	for (size_t i = 0; i < retired.size(); i++)
+		delete retired[i];
+}
+
+/*
+ * The version is marked in the slot, then checked to still be current.
+ * A writer that swapped it out before the check is seen and the new one
+ * is tried instead, one that swaps it out after sees the mark when it
+ * scans the slots.  Both need the sequentially consistent default.
+ */
+JsonPublished::snapshot JsonPublished::read() const {
+	snapshot s;
+	const JsonFrozen *p = current.load(std::memory_order_acquire);
+	if (!p)
+		return s;
+	s.slot = hazard::acquire();
+	for (;;) {
+		s.slot->pointer.store(p);
+		const JsonFrozen *q = current.load();
+		if (q == p)
+			break;
+		p = q;
+	}
+	s.document = p;
+	return s;
+}
+
+void JsonPublished::publish(JsonFrozen &document) {
+	JsonFrozen *next = new JsonFrozen();
+	next->swap(document);
+	std::lock_guard<std::mutex> lock(writer);
+	JsonFrozen *old = current.exchange(next);
+	if (old)
+		retired.push_back(old);
+	reclaimLocked();
+}
+
+void JsonPublished::publish(JsonView document) {
+	JsonFrozen frozen(document);
+	publish(frozen);
+}
+
+bool JsonPublished::reload(const char *file, JsonError &error) {
+	return reload(file, JsonHandle::defaultParseOptions, error);
+}
+
+bool JsonPublished::reload(const char *file, const JsonParseOptions &options,
+		JsonError &error) {
+	// decoded and frozen before any lock, readers keep the old version
+	JsonResult result = JsonHandle::parseFile(file, options);
+	error = result.error;
+	if (!result.ok())
+		return false;
+	publish(result.value.view());
+	return true;
+}
+
+size_t JsonPublished::reclaim() {
+	std::lock_guard<std::mutex> lock(writer);
+	return reclaimLocked();
+}
+
+size_t JsonPublished::reclaimLocked() {
+	if (retired.empty())
+		return 0;
+	std::vector<const JsonFrozen *> held;
+	for (hazard *h = hazard::list.load(std::memory_order_acquire); h;
+			h = h->next) {
+		const JsonFrozen *p = h->pointer.load();
+		if (p)
+			held.push_back(p);
+	}
+	std::sort(held.begin(), held.end());
+	size_t kept = 0;
+	for (size_t i = 0; i < retired.size(); i++) {
+		if (std::binary_search(held.begin(), held.end(),
+				(const JsonFrozen *) retired[i]))
+			retired[kept++] = retired[i];
+		else
+			delete retired[i];
+	}
+	retired.resize(kept);
+	return kept;
+}
+
+#endif /* JSON_HAS_CXX11 */
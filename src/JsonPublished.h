@@ -0,0 +1,176 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __JSONPUBLISHED_H__
+#define __JSONPUBLISHED_H__
+
+#include "JsonKey.h"
+
+#ifdef JSON_HAS_CXX11
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "JsonFrozen.h"
+#include "JsonReader.h"
+
+/**
+ * class: JsonPublished
+ *
+ * Holds the current version of a frozen document, such as a
+ * configuration, for many reader threads while a writer replaces it.
+ * Readers take a snapshot, which pins the version they see without a lock
+ * or a shared counter: each thread marks the version in a hazard slot of
+ * its own.  A writer parses and freezes the new version first, then swaps
+ * it in with one atomic exchange.  Old versions are freed by writers once
+ * no snapshot holds them, so readers never wait and never free anything.
+ * Needs C++11.
+ *
+ * For example:
+ *    JsonPublished config;
+ *    config.reload("service.json", error);    // at start and on SIGHUP
+ *
+ *    // in any thread
+ *    JsonPublished::snapshot s = config.read();
+ *    int64_t timeout = s.root()["timeout"].longValue(30);
+ *
+ * Keep snapshots short, a version can not be freed while one holds it.
+ */
+class JsonPublished {
+	struct hazard;
+public:
+
+	/**
+	 * snapshot - the version of the document current when it was taken,
+	 *   valid until the snapshot is destroyed.  Snapshots can be moved
+	 *   but not copied, and belong to the thread that took them.
+	 */
+	class snapshot {
+		friend class JsonPublished;
+	public:
+		snapshot(snapshot &&other) :
+				slot(other.slot), document(other.document) {
+			other.slot = 0;
+			other.document = 0;
+		}
+
+		~snapshot();
+
+		/**
+		 * operator= - releases the version this snapshot holds and takes
+		 *   over the one held by other, which is left empty.
+		 */
+		snapshot &operator=(snapshot &&other);
+
+		/**
+		 * root - a view of the document, undefined when nothing was
+		 *   published.
+		 */
+		JsonFrozenView root() const {
+			return document ? document->root() : JsonFrozenView();
+		}
+
+		operator JsonFrozenView() const {
+			return root();
+		}
+
+		snapshot(const snapshot &) = delete;
+		snapshot &operator=(const snapshot &) = delete;
+
+	private:
+		snapshot() :
+				slot(0), document(0) {
+		}
+
+		hazard *slot;
+		const JsonFrozen *document;
+	};
+
+	/**
+	 * Constructor - creates a holder with nothing published.
+	 */
+	JsonPublished() :
+			current(0) {
+	}
+
+	/**
+	 * Destructor - frees every version.  No snapshot may be left.
+	 */
+	~JsonPublished();
+
+	/**
+	 * read - takes a snapshot of the current version.  Never locks.
+	 */
+	snapshot read() const;
+
+	/**
+	 * publish - makes document the current version, taking its data and
+	 *   leaving it empty.  Readers switch to it with their next snapshot.
+	 */
+	void publish(JsonFrozen &document);
+
+	/**
+	 * publish - freezes document and makes it the current version.
+	 */
+	void publish(JsonView document);
+
+	/**
+	 * reload - decodes and freezes the file, then publishes it.  On
+	 *   failure the current version is kept and the reason is stored in
+	 *   error.
+	 * @returns
+	 *   true when the file was published.
+	 */
+	bool reload(const char *file, JsonError &error);
+
+	/**
+	 * reload - as above, with options in place of
+	 *   JsonHandle::defaultParseOptions.
+	 */
+	bool reload(const char *file, const JsonParseOptions &options,
+			JsonError &error);
+
+	/**
+	 * reclaim - frees old versions that no snapshot holds any more.
+	 *   publish() does this too, call it to free versions held through the
+	 *   last publish without waiting for the next.
+	 * @returns
+	 *   the number of old versions still held.
+	 */
+	size_t reclaim();
+
+	JsonPublished(const JsonPublished &) = delete;
+	JsonPublished &operator=(const JsonPublished &) = delete;
+
+private:
+	size_t reclaimLocked();
+
+	std::atomic<JsonFrozen *> current;
+	std::mutex writer; // publishers only
+	std::vector<JsonFrozen *> retired; // replaced, maybe still read
+};
+
+#endif /* JSON_HAS_CXX11 */
+
+#endif /* __JSONPUBLISHED_H__ */
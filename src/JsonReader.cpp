@@ -0,0 +1,1260 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "JsonReader.h"
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#define snprintf _snprintf
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) \
+		|| defined(_M_X64) || defined(_M_IX86) || defined(_M_ARM64)
+#define JSON_LITTLE_ENDIAN
+#endif
+
+static const uint64_t MAX_INT64 = 0x7FFFFFFFFFFFFFFFULL;
+static const uint64_t MAX_UINT64 = 0xFFFFFFFFFFFFFFFFULL;
+
+#define HEX(c) ((c >= '0' && c <= '9') ? (c - '0') : (c >= 'a' && c <= 'f') ? ((c - 'a') + 10) : (c >= 'A' && c <= 'F') ? ((c - 'A') + 10) :  -1)
+
+// a character that may follow a backslash in RFC 8259
+static inline bool isEscape(int c) {
+	return c != 0 && strchr("\"\\/bfnrtu", c) != 0;
+}
+
+const char *JsonError::message(Code code) {
+	switch (code) {
+	case NONE:
+		return "no error";
+	case NO_VALUE:
+		return "no value";
+	case MISSING_VALUE:
+		return "syntax error: missing value";
+	case INVALID_NULL:
+		return "syntax error: invalid null value";
+	case INVALID_BOOLEAN:
+		return "syntax error: invalid boolean value";
+	case INVALID_NUMBER:
+		return "syntax error: invalid number";
+	case INVALID_STRING:
+		return "syntax error: invalid string";
+	case INVALID_KEY:
+		return "syntax error: invalid string for object key";
+	case KEY_NOT_STRING:
+		return "syntax error: object key must be a string";
+	case COLON_EXPECTED:
+		return "syntax error: object colon expected";
+	case OBJECT_COMMA_EXPECTED:
+		return "syntax error: object comma or end expected";
+	case ARRAY_COMMA_EXPECTED:
+		return "syntax error: array comma or end expected";
+	case OBJECT_NOT_CLOSED:
+		return "syntax error: object not closed";
+	case ARRAY_NOT_CLOSED:
+		return "syntax error: array not closed";
+	case CONTAINER_NOT_CLOSED:
+		return "syntax error: container not closed";
+	case TRAILING_DATA:
+		return "syntax error: data after value";
+	case INVALID_UTF8:
+		return "syntax error: invalid UTF-8 in string";
+	case TOO_DEEP:
+		return "limit error: nesting too deep";
+	case TOO_MANY_NODES:
+		return "limit error: too many nodes";
+	case STRING_TOO_LONG:
+		return "limit error: string too long";
+	case TOO_LARGE:
+		return "limit error: document too large";
+	case IO_ERROR:
+		return "could not read file";
+	case INVALID_HANDLE:
+		return "invalid handle";
+	}
+	return "unknown error";
+}
+
+JsonReader::JsonReader() :
+		begin(0), p(0), end(0), sb(0), pos(0), atEof(false), cur(END), pending(false), decoded(
+				false), first(false), dbl(false), converted(false), numText(0), numLength(
+				0), numKind(NUM_INT64), lngValue(0), ulngValue(0), dblValue(0), booValue(false), code(
+				JsonError::NONE) {
+}
+
+JsonReader::JsonReader(const char *buffer, size_t length) :
+		sb(0), pos(0), numKind(NUM_INT64), lngValue(0), ulngValue(0), dblValue(0), booValue(false) {
+	reset(buffer, length);
+}
+
+JsonReader::JsonReader(const std::string &buffer) :
+		sb(0), pos(0), numKind(NUM_INT64), lngValue(0), ulngValue(0), dblValue(0), booValue(false) {
+	reset(buffer.data(), buffer.length());
+}
+
+JsonReader::JsonReader(std::istream &stream) :
+		begin(0), p(0), end(0), numKind(NUM_INT64), lngValue(0), ulngValue(0), dblValue(0), booValue(false) {
+	reset(stream);
+}
+
+void JsonReader::reset(const char *buffer, size_t length) {
+	begin = p = buffer;
+	end = buffer ? buffer + length : buffer;
+	sb = 0;
+	pos = 0;
+	atEof = false;
+	cur = END;
+	pending = decoded = first = dbl = converted = false;
+	stack.clear();
+	keyBuf.clear();
+	code = JsonError::NONE;
+}
+
+void JsonReader::reset(std::istream &stream) {
+	begin = p = end = 0;
+	sb = stream.rdbuf();
+	pos = 0;
+	atEof = false;
+	cur = END;
+	pending = decoded = first = dbl = converted = false;
+	stack.clear();
+	keyBuf.clear();
+	code = JsonError::NONE;
+}
+
+JsonReader::Type JsonReader::fail(JsonError::Code error) {
+	if (cur == INVALID)
+		return INVALID; // keep the first error
+	cur = INVALID;
+	pending = false;
+	code = error;
+	return INVALID;
+}
+
+void JsonReader::skipWhiteSpace() {
+	if (!sb) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+			p++;
+		return;
+	}
+	for (int c = peek(); c == ' ' || c == '\t' || c == '\n' || c == '\r'; c =
+			peek())
+		advance();
+}
+
+JsonReader::Type JsonReader::next() {
+	if (cur == INVALID)
+		return INVALID;
+	if (pending && !finishValue())
+		return INVALID;
+	if (opts.maxBytes && !sb && (size_t) (end - begin) > opts.maxBytes)
+		return fail(JsonError::TOO_LARGE);
+	skipWhiteSpace();
+	int c = peek();
+	if (!stack.empty()) {
+		char closer = (stack.back() == '{') ? '}' : ']';
+		if (!first && c != closer) {
+			if (c != ',')
+				return fail(
+						(closer == '}') ?
+								JsonError::OBJECT_COMMA_EXPECTED :
+								JsonError::ARRAY_COMMA_EXPECTED);
+			advance();
+			skipWhiteSpace();
+			c = peek();
+			if (opts.strict && c == closer)
+				return fail(
+						(closer == '}') ?
+								JsonError::KEY_NOT_STRING :
+								JsonError::MISSING_VALUE);
+		}
+		if (c == closer) {
+			advance();
+			if (opts.maxBytes && sb && pos > opts.maxBytes)
+				return fail(JsonError::TOO_LARGE);
+			stack.pop_back();
+			first = false;
+			decoded = false;
+			return cur = (closer == '}') ? END_OBJECT : END_ARRAY;
+		}
+		first = false;
+		if (closer == '}') {
+			if (c != '"')
+				return fail(
+						(c == 0) ?
+								JsonError::OBJECT_NOT_CLOSED :
+								JsonError::KEY_NOT_STRING);
+			if (!parseString(keyBuf))
+				return fail(JsonError::INVALID_KEY);
+			skipWhiteSpace();
+			if (peek() != ':')
+				return fail(JsonError::COLON_EXPECTED);
+			advance();
+			skipWhiteSpace();
+			c = peek();
+		}
+	}
+	if (opts.maxBytes && sb && pos > opts.maxBytes)
+		return fail(JsonError::TOO_LARGE);
+	return startValue(c);
+}
+
+JsonReader::Type JsonReader::startValue(int c) {
+	decoded = false;
+	pending = true;
+	switch (c) {
+	case '"':
+		return cur = STRING;
+	case '{':
+		return cur = OBJECT;
+	case '[':
+		return cur = ARRAY;
+	case '-':
+	case '+':
+	case '0':
+	case '1':
+	case '2':
+	case '3':
+	case '4':
+	case '5':
+	case '6':
+	case '7':
+	case '8':
+	case '9':
+		return cur = NUMBER;
+	case 't':
+	case 'f':
+		pending = false;
+		decoded = true;
+		booValue = (c == 't');
+		if (!parseLiteral(booValue ? "true" : "false"))
+			return fail(JsonError::INVALID_BOOLEAN);
+		return cur = BOOLEAN;
+	case 'n':
+		pending = false;
+		decoded = true;
+		if (!parseLiteral("null"))
+			return fail(JsonError::INVALID_NULL);
+		return cur = NULLVALUE;
+	case 0:
+		pending = false;
+		if (!stack.empty())
+			return fail(
+					(stack.back() == '{') ?
+							JsonError::OBJECT_NOT_CLOSED :
+							JsonError::ARRAY_NOT_CLOSED);
+		return cur = END;
+	default:
+		return fail(JsonError::MISSING_VALUE);
+	}
+}
+
+bool JsonReader::finishValue() {
+	pending = false;
+	switch (cur) {
+	case OBJECT:
+	case ARRAY:
+		if (opts.maxDepth && stack.size() >= opts.maxDepth) {
+			fail(JsonError::TOO_DEEP);
+			return false;
+		}
+		stack.push_back((cur == OBJECT) ? '{' : '[');
+		advance();
+		first = true;
+		return true;
+	case STRING:
+		return skipString();
+	case NUMBER:
+		if (!scanNumber()) {
+			fail(JsonError::INVALID_NUMBER);
+			return false;
+		}
+		return true;
+	default:
+		return true;
+	}
+}
+
+bool JsonReader::enterObject() {
+	if (cur != OBJECT || !pending)
+		return false;
+	return finishValue();
+}
+
+bool JsonReader::enterArray() {
+	if (cur != ARRAY || !pending)
+		return false;
+	return finishValue();
+}
+
+bool JsonReader::leaveObject() {
+	if (stack.empty() || stack.back() != '{' || cur == INVALID)
+		return false;
+	if (pending && !skipValue())
+		return false;
+	if (!skipContainer(1))
+		return false;
+	stack.pop_back();
+	first = false;
+	cur = END_OBJECT;
+	return true;
+}
+
+bool JsonReader::leaveArray() {
+	if (stack.empty() || stack.back() != '[' || cur == INVALID)
+		return false;
+	if (pending && !skipValue())
+		return false;
+	if (!skipContainer(1))
+		return false;
+	stack.pop_back();
+	first = false;
+	cur = END_ARRAY;
+	return true;
+}
+
+bool JsonReader::skipValue() {
+	if (cur == INVALID)
+		return false;
+	if (!pending)
+		return true;
+	if (cur == OBJECT || cur == ARRAY) {
+		pending = false;
+		advance();
+		return skipContainer(1);
+	}
+	return finishValue();
+}
+
+int JsonReader::nextKey(const JsonKeySet &keys) {
+	if (!skipValue() || !inObject())
+		return -1;
+	while (1) {
+		Type t = next();
+		if (t < NULLVALUE || t > ARRAY)
+			return -1;
+		int k = keys.find(keyBuf);
+		if (k >= 0)
+			return k;
+		if (!skipValue())
+			return -1;
+	}
+}
+
+/*
+ * Bytes the skip scanner has to look at: quotes, brackets and the
+ * terminating zero.  Everything else is passed over without a branch.
+ */
+static const unsigned char structural[256] = {
+		1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+/*
+ * Returns the position after the closing quote of a string whose opening
+ * quote is just before p, or NULL if the string is not closed.  A quote is
+ * escaped only when it follows an odd number of backslashes.
+ */
+static const char *skipQuoted(const char *p, const char *end) {
+	while (1) {
+		const char *q = (const char *) memchr(p, '"', end - p);
+		if (q == 0)
+			return 0;
+		const char *b = q;
+		while (b > p && b[-1] == '\\')
+			b--;
+		p = q + 1;
+		if (((q - b) & 1) == 0)
+			return p;
+	}
+}
+
+/*
+ * Moves past the closing bracket of a container that is depth levels
+ * deep, matching brackets and quotes only.  Strings are not unescaped
+ * and numbers are not converted.
+ */
+bool JsonReader::skipContainer(int depth) {
+	if (!sb) {
+		while (p < end) {
+			while (p < end && !structural[(unsigned char) *p])
+				p++;
+			if (p == end)
+				break;
+			char c = *p++;
+			if (c == '"') {
+				const char *q = skipQuoted(p, end);
+				if (q == 0) {
+					p = end;
+					break;
+				}
+				p = q;
+			} else if (c == '{' || c == '[')
+				depth++;
+			else if (c == '}' || c == ']') {
+				if (--depth == 0)
+					return true;
+			} else
+				break;
+		}
+	} else {
+		for (int c = peek(); c != 0; c = peek()) {
+			if (opts.maxBytes && pos > opts.maxBytes) {
+				fail(JsonError::TOO_LARGE);
+				return false;
+			}
+			if (c == '"') {
+				if (!skipString())
+					return false;
+				continue;
+			}
+			advance();
+			if (c == '{' || c == '[')
+				depth++;
+			else if (c == '}' || c == ']') {
+				if (--depth == 0)
+					return true;
+			}
+		}
+	}
+	fail(JsonError::CONTAINER_NOT_CLOSED);
+	return false;
+}
+
+bool JsonReader::parseLiteral(const char *literal) {
+	for (; *literal; literal++) {
+		if (peek() != *literal)
+			return false;
+		advance();
+	}
+	return true;
+}
+
+bool JsonReader::skipString() {
+	advance(); // opening quote
+	if (!sb) {
+		while (p < end) {
+			char c = *p++;
+			if (c == '"')
+				return true;
+			if (c == '\\') {
+				if (p >= end || *p == 0)
+					break;
+				c = *p++;
+				if (c == 'u') {
+					int i = 0;
+					for (; i < 4 && p < end && HEX(*p) != -1; i++)
+						p++;
+					if (i < 4)
+						break;
+				} else if (opts.strict && !isEscape(c))
+					break;
+			} else if (c == 0 || (opts.strict && (unsigned char) c < 0x20))
+				break;
+		}
+	} else {
+		for (int c = peek(); c != 0; c = peek()) {
+			advance();
+			if (c == '"')
+				return true;
+			if (c == '\\') {
+				c = peek();
+				if (c == 0)
+					break;
+				advance();
+				if (c == 'u') {
+					int i = 0;
+					for (; i < 4 && HEX(peek()) != -1; i++)
+						advance();
+					if (i < 4)
+						break;
+				} else if (opts.strict && !isEscape(c))
+					break;
+			} else if (opts.strict && c < 0x20)
+				break;
+		}
+	}
+	fail(JsonError::INVALID_STRING);
+	return false;
+}
+
+/*
+ * Returns the first quote, backslash or zero byte at or after p, or end.
+ */
+static const char *scanRun(const char *p, const char *end) {
+#ifdef JSON_HAS_SSE2
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i zero = _mm_setzero_si128();
+	for (; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) p);
+		int mask = _mm_movemask_epi8(
+				_mm_or_si128(
+						_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+								_mm_cmpeq_epi8(v, backslash)),
+						_mm_cmpeq_epi8(v, zero)));
+		if (mask != 0) {
+			while ((mask & 1) == 0) {
+				mask >>= 1;
+				p++;
+			}
+			return p;
+		}
+	}
+#endif
+	while (p < end && *p != '"' && *p != '\\' && *p != 0)
+		p++;
+	return p;
+}
+
+bool JsonReader::closeString(const std::string &out) {
+	if (opts.validateUtf8 && !isValidUtf8(out.data(), out.length())) {
+		fail(JsonError::INVALID_UTF8);
+		return false;
+	}
+	return true;
+}
+
+bool JsonReader::parseString(std::string &out) {
+	size_t limit = opts.maxStringLength ? opts.maxStringLength : (size_t) -1;
+	out.clear();
+	advance(); // opening quote
+	if (!sb) {
+		while (1) {
+			const char *run = p;
+			p = scanRun(p, end);
+			if (opts.strict)
+				for (const char *q = run; q < p; q++)
+					if ((unsigned char) *q < 0x20)
+						return false;
+			if ((size_t) (p - run) > limit - out.length()) {
+				fail(JsonError::STRING_TOO_LONG);
+				return false;
+			}
+			if (p != run)
+				out.append(run, p - run);
+			if (p >= end || *p == 0)
+				return false;
+			if (*p++ == '"')
+				return closeString(out);
+			if (!parseEscape(out, limit))
+				return false;
+		}
+	}
+	for (int c = peek(); c != 0; c = peek()) {
+		advance();
+		if (c == '"')
+			return closeString(out);
+		if (out.length() >= limit) {
+			fail(JsonError::STRING_TOO_LONG);
+			return false;
+		}
+		if (opts.strict && c < 0x20)
+			return false;
+		if (c != '\\')
+			out.push_back((char) c);
+		else if (!parseEscape(out, limit))
+			return false;
+	}
+	return false;
+}
+
+/*
+ * Decodes an escape sequence, the backslash has already been consumed.
+ * Fails before out would grow past limit.
+ */
+bool JsonReader::parseEscape(std::string &out, size_t limit) {
+	int c = peek();
+	if (c == 0)
+		return false;
+	advance();
+	unsigned code;
+	switch (c) {
+	case '"':
+	case '\\':
+	case '/':
+		code = c;
+		break;
+	case 'n':
+		code = '\n';
+		break;
+	case 't':
+		code = '\t';
+		break;
+	case 'r':
+		code = '\r';
+		break;
+	case 'f':
+		code = '\f';
+		break;
+	case 'b':
+		code = '\b';
+		break;
+	case 'u':
+		if (!parseHex4(code))
+			return false;
+		// a high surrogate must be followed by an escaped low one,
+		// anything else is replaced by U+FFFD
+		while (code >= 0xD800 && code <= 0xDBFF) {
+			if (peek() != '\\') {
+				code = 0xFFFD;
+				break;
+			}
+			advance();
+			if (peek() != 'u') {
+				if (!appendCode(out, 0xFFFD, limit))
+					return false;
+				return parseEscape(out, limit);
+			}
+			advance();
+			unsigned low;
+			if (!parseHex4(low))
+				return false;
+			if (low >= 0xDC00 && low <= 0xDFFF) {
+				code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				break;
+			}
+			if (!appendCode(out, 0xFFFD, limit))
+				return false;
+			code = low;
+		}
+		if (code >= 0xDC00 && code <= 0xDFFF)
+			code = 0xFFFD;
+		break;
+	default:
+		if (opts.strict)
+			return false;
+		// assume it was not a real escape sequence
+		// as it is outside the JSON specification
+		if (limit - out.length() < 2) {
+			fail(JsonError::STRING_TOO_LONG);
+			return false;
+		}
+		out.push_back('\\');
+		out.push_back((char) c);
+		return true;
+	}
+	return appendCode(out, code, limit);
+}
+
+/*
+ * Appends code as UTF-8 unless out would grow past limit.
+ */
+bool JsonReader::appendCode(std::string &out, unsigned code, size_t limit) {
+	size_t n = (code < 0x80) ? 1 : (code < 0x800) ? 2 :
+			(code < 0x10000) ? 3 : 4;
+	if (n > limit - out.length()) {
+		fail(JsonError::STRING_TOO_LONG);
+		return false;
+	}
+	appendUtf8(out, code);
+	return true;
+}
+
+bool JsonReader::parseHex4(unsigned &code) {
+	code = 0;
+	for (int i = 0; i < 4; i++) {
+		int h = HEX(peek());
+		if (h == -1)
+			return false;
+		advance();
+		code = (code << 4) | h;
+	}
+	return true;
+}
+
+void JsonReader::appendUtf8(std::string &out, unsigned code) {
+	if (code < 0x80)
+		out.push_back((char) code);
+	else if (code < 0x800) {
+		out.push_back((char) (0xC0 | (code >> 6)));
+		out.push_back((char) (0x80 | (code & 0x3F)));
+	} else if (code < 0x10000) {
+		out.push_back((char) (0xE0 | (code >> 12)));
+		out.push_back((char) (0x80 | ((code >> 6) & 0x3F)));
+		out.push_back((char) (0x80 | (code & 0x3F)));
+	} else {
+		out.push_back((char) (0xF0 | (code >> 18)));
+		out.push_back((char) (0x80 | ((code >> 12) & 0x3F)));
+		out.push_back((char) (0x80 | ((code >> 6) & 0x3F)));
+		out.push_back((char) (0x80 | (code & 0x3F)));
+	}
+}
+
+/*
+ * Returns the length of the leading run of bytes below 0x80, looking at
+ * 16 bytes per step with SSE2 or 8 with plain 64 bit words.
+ */
+static size_t asciiPrefix(const char *s, size_t length) {
+	size_t i = 0;
+#ifdef JSON_HAS_SSE2
+	for (; i + 16 <= length; i += 16) {
+		int mask = _mm_movemask_epi8(
+				_mm_loadu_si128((const __m128i *) (s + i)));
+		if (mask != 0) {
+			while ((mask & 1) == 0) {
+				mask >>= 1;
+				i++;
+			}
+			return i;
+		}
+	}
+#endif
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		memcpy(&word, s + i, 8);
+		if (word & 0x8080808080808080ULL)
+			break;
+	}
+	while (i < length && (unsigned char) s[i] < 0x80)
+		i++;
+	return i;
+}
+
+bool JsonReader::isValidUtf8(const char *s, size_t length) {
+	size_t i = 0;
+	while (1) {
+		i += asciiPrefix(s + i, length - i);
+		if (i == length)
+			return true;
+		unsigned char c = (unsigned char) s[i];
+		size_t n;
+		unsigned code, min;
+		if ((c & 0xE0) == 0xC0) {
+			n = 2;
+			min = 0x80;
+		} else if ((c & 0xF0) == 0xE0) {
+			n = 3;
+			min = 0x800;
+		} else if ((c & 0xF8) == 0xF0) {
+			n = 4;
+			min = 0x10000;
+		} else
+			return false;
+		if (length - i < n)
+			return false;
+		code = c & (0x7F >> n);
+		for (size_t k = 1; k < n; k++) {
+			c = (unsigned char) s[i + k];
+			if ((c & 0xC0) != 0x80)
+				return false;
+			code = (code << 6) | (c & 0x3F);
+		}
+		// no overlong forms, surrogates or values past U+10FFFF
+		if (code < min || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+			return false;
+		i += n;
+	}
+}
+
+/*
+ * Finds the end of the number at the cursor without converting it.  The
+ * text is used in place in a buffer and copied when read from a stream.
+ */
+bool JsonReader::scanNumber() {
+	if (!sb) {
+		const char *s = p;
+		if (p < end && *p == '-')
+			p++;
+		if (p >= end || *p < '0' || *p > '9')
+			return false;
+		const char *digits = p;
+		while (p < end && *p >= '0' && *p <= '9')
+			p++;
+		if (opts.strict && *digits == '0' && p - digits > 1)
+			return false;
+		dbl = (p < end && *p == '.');
+		if (dbl) {
+			digits = ++p;
+			while (p < end && *p >= '0' && *p <= '9')
+				p++;
+			if (opts.strict && p == digits)
+				return false;
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			dbl = true;
+			p++;
+			if (p < end && (*p == '+' || *p == '-'))
+				p++;
+			if (p >= end || *p < '0' || *p > '9')
+				return false;
+			while (p < end && *p >= '0' && *p <= '9')
+				p++;
+		}
+		numText = s;
+		numLength = p - s;
+	} else {
+		numBuf.clear();
+		int c = peek();
+		if (c == '-') {
+			numBuf.push_back('-');
+			advance();
+			c = peek();
+		}
+		if (c < '0' || c > '9')
+			return false;
+		size_t digits = numBuf.length();
+		for (; c >= '0' && c <= '9'; c = peek()) {
+			numBuf.push_back((char) c);
+			advance();
+		}
+		if (opts.strict && numBuf[digits] == '0'
+				&& numBuf.length() - digits > 1)
+			return false;
+		dbl = (c == '.');
+		if (dbl) {
+			numBuf.push_back('.');
+			advance();
+			digits = numBuf.length();
+			for (c = peek(); c >= '0' && c <= '9'; c = peek()) {
+				numBuf.push_back((char) c);
+				advance();
+			}
+			if (opts.strict && numBuf.length() == digits)
+				return false;
+		}
+		if (c == 'e' || c == 'E') {
+			dbl = true;
+			numBuf.push_back((char) c);
+			advance();
+			c = peek();
+			if (c == '+' || c == '-') {
+				numBuf.push_back((char) c);
+				advance();
+				c = peek();
+			}
+			if (c < '0' || c > '9')
+				return false;
+			for (; c >= '0' && c <= '9'; c = peek()) {
+				numBuf.push_back((char) c);
+				advance();
+			}
+		}
+		numText = numBuf.data();
+		numLength = numBuf.length();
+	}
+	decoded = true;
+	converted = false;
+	return true;
+}
+
+/*
+ * Converts eight ASCII digits at once: pairs, then quads, then the whole
+ * word are combined with two multiplications.
+ */
+static inline uint64_t parseEightDigits(const char *s) {
+	uint64_t v;
+	memcpy(&v, s, 8);
+	v -= 0x3030303030303030ULL;
+	v = (v * 10) + (v >> 8);
+	v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+			+ (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))))
+			>> 32;
+	return v;
+}
+
+// n digits, at most 19 so the value cannot overflow
+static inline uint64_t parseDigits(const char *s, size_t n) {
+	uint64_t v = 0;
+#ifdef JSON_LITTLE_ENDIAN
+	for (; n >= 8; n -= 8, s += 8)
+		v = v * 100000000 + parseEightDigits(s);
+#endif
+	for (; n > 0; n--)
+		v = v * 10 + (*s++ - '0');
+	return v;
+}
+
+// 10^n, exact up to 10^27 with a 64 bit mantissa
+static long double powerOfTen(int n) {
+	static const long double table[] = { 1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L,
+			1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L,
+			1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L,
+			1e25L, 1e26L, 1e27L };
+	long double r = 1;
+	for (; n > 27; n -= 27)
+		r *= table[27];
+	return r * table[n];
+}
+
+/*
+ * Converts number text accepted by scanNumber().  Integers are converted
+ * eight digits at a time and checked for overflow: those that do not fit
+ * an int64_t but fit a uint64_t are NUM_UINT64, larger ones are NUM_BIG
+ * and only approximated by dbl.  Other numbers are rounded to 19
+ * significant digits and scaled by a power of ten.  lng and ulng are
+ * clamped to their range.
+ * @returns
+ *    the kind of number.
+ */
+int JsonReader::convertNumber(const char *s, size_t length, int64_t &lng,
+		uint64_t &ulng, long double &dbl) {
+	const char *end = s + length;
+	bool isneg = (s < end && *s == '-');
+	if (isneg)
+		s++;
+	const char *digits = s;
+	while (s < end && *s >= '0' && *s <= '9')
+		s++;
+	bool integer = (s == end);
+	if (integer) {
+		const char *d = digits;
+		while (d < end - 1 && *d == '0')
+			d++;
+		size_t n = end - d;
+		if (n <= 20) {
+			uint64_t v = parseDigits(d, (n < 19) ? n : 19);
+			bool fits = true;
+			if (n == 20) {
+				unsigned last = d[19] - '0';
+				fits = (v <= (MAX_UINT64 - last) / 10);
+				v = v * 10 + last;
+			}
+			if (fits && !isneg) {
+				ulng = v;
+				lng = (v <= MAX_INT64) ? (int64_t) v : (int64_t) MAX_INT64;
+				dbl = (long double) v;
+				return (v <= MAX_INT64) ? NUM_INT64 : NUM_UINT64;
+			}
+			if (fits && v <= MAX_INT64 + 1) {
+				lng = (int64_t) (0 - v);
+				ulng = 0;
+				dbl = (long double) lng;
+				return NUM_INT64;
+			}
+		}
+	}
+
+	// significand of up to 19 digits and a decimal exponent
+	uint64_t sig = 0;
+	int count = 0, exp10 = 0;
+	bool fraction = false, dropped = false, roundUp = false;
+	for (s = digits; s < end && *s != 'e' && *s != 'E'; s++) {
+		if (*s == '.') {
+			fraction = true;
+			continue;
+		}
+		if (fraction)
+			exp10--;
+		if (count == 0 && *s == '0')
+			continue;
+		if (count < 19) {
+			sig = sig * 10 + (*s - '0');
+			count++;
+		} else {
+			if (!dropped)
+				roundUp = (*s >= '5');
+			dropped = true;
+			exp10++;
+		}
+	}
+	if (roundUp)
+		sig++;
+	if (s < end) {
+		bool eneg = (*++s == '-');
+		if (*s == '+' || *s == '-')
+			s++;
+		int e = 0;
+		for (; s < end; s++)
+			if (e < 100000)
+				e = e * 10 + (*s - '0');
+		exp10 += eneg ? -e : e;
+	}
+	long double v = (long double) sig;
+	if (sig != 0 && exp10 != 0) {
+		if (exp10 < -6000)
+			exp10 = -6000;
+		else if (exp10 > 6000)
+			exp10 = 6000;
+		if (exp10 < 0)
+			v /= powerOfTen(-exp10);
+		else
+			v *= powerOfTen(exp10);
+	}
+	dbl = isneg ? -v : v;
+	lng = clampInt64(dbl);
+	ulng = clampUInt64(dbl);
+	return integer ? NUM_BIG : NUM_DOUBLE;
+}
+
+int64_t JsonReader::clampInt64(long double value) {
+	if (value != value)
+		return 0;
+	if (value >= (long double) MAX_INT64)
+		return (int64_t) MAX_INT64;
+	if (value <= -(long double) MAX_INT64 - 1)
+		return -(int64_t) MAX_INT64 - 1;
+	return (int64_t) value;
+}
+
+uint64_t JsonReader::clampUInt64(long double value) {
+	if (!(value > 0))
+		return 0;
+	if (value >= (long double) MAX_UINT64)
+		return MAX_UINT64;
+	return (uint64_t) value;
+}
+
+/*
+ * Reads the current number if that was not done yet and, when convert
+ * is set, converts it.
+ * @returns
+ *    false if the current token is not a valid number.
+ */
+bool JsonReader::decodeNumber(bool convert) {
+	if (cur != NUMBER)
+		return false;
+	if (pending) {
+		pending = false;
+		if (!scanNumber()) {
+			fail(JsonError::INVALID_NUMBER);
+			return false;
+		}
+	}
+	if (!decoded)
+		return false;
+	if (convert && !converted) {
+		numKind = convertNumber(numText, numLength, lngValue, ulngValue,
+				dblValue);
+		converted = true;
+	}
+	return true;
+}
+
+bool JsonReader::getBoolean(bool defaultValue) {
+	return (cur == BOOLEAN) ? booValue : defaultValue;
+}
+
+int64_t JsonReader::getInt64(int64_t defaultValue) {
+	return decodeNumber(true) ? lngValue : defaultValue;
+}
+
+uint64_t JsonReader::getUInt64(uint64_t defaultValue) {
+	return decodeNumber(true) ? ulngValue : defaultValue;
+}
+
+long double JsonReader::getDouble(long double defaultValue) {
+	return decodeNumber(true) ? dblValue : defaultValue;
+}
+
+bool JsonReader::isDouble() {
+	return decodeNumber(false) && dbl;
+}
+
+bool JsonReader::isUInt64() {
+	return decodeNumber(true) && numKind == NUM_UINT64;
+}
+
+bool JsonReader::getNumberText(std::string &to) {
+	if (!decodeNumber(false))
+		return false;
+	to.assign(numText, numLength);
+	return true;
+}
+
+const std::string &
+JsonReader::getString() {
+	if (cur == STRING && pending) {
+		pending = false;
+		decoded = parseString(strBuf);
+		if (!decoded)
+			fail(JsonError::INVALID_STRING);
+	}
+	if (cur != STRING || !decoded)
+		strBuf.clear();
+	return strBuf;
+}
+
+bool JsonReader::getString(std::string &to) {
+	if (cur != STRING)
+		return false;
+	if (pending) {
+		pending = false;
+		if (!parseString(to)) {
+			fail(JsonError::INVALID_STRING);
+			return false;
+		}
+		return true;
+	}
+	if (!decoded)
+		return false;
+	to = strBuf;
+	return true;
+}
+
+JsonProjection::JsonProjection() :
+		root(newSegment(std::string())) {
+}
+
+JsonProjection::JsonProjection(const char *path) :
+		root(newSegment(std::string())) {
+	add(path);
+}
+
+JsonProjection::JsonProjection(const JsonProjection &from) :
+		root(cloneSegment(from.root)) {
+}
+
+JsonProjection &
+JsonProjection::operator=(const JsonProjection &from) {
+	if (&from != this) {
+		segment *seg = cloneSegment(from.root);
+		freeSegment(root);
+		root = seg;
+	}
+	return *this;
+}
+
+JsonProjection::~JsonProjection() {
+	freeSegment(root);
+}
+
+JsonProjection &
+JsonProjection::add(const char *path) {
+	return add(std::string(path ? path : ""));
+}
+
+JsonProjection &
+JsonProjection::add(const std::string &path) {
+	std::vector<std::string> segments;
+	if (!path.empty()) {
+		size_t b = 0;
+		while (1) {
+			size_t e = path.find('.', b);
+			segments.push_back(path.substr(b, e - b));
+			if (e == std::string::npos)
+				break;
+			b = e + 1;
+		}
+	}
+	insert(root, segments, 0);
+	return *this;
+}
+
+void JsonProjection::clear() {
+	freeSegment(root);
+	root = newSegment(std::string());
+}
+
+JsonProjection::segment *
+JsonProjection::newSegment(const std::string &key) {
+	segment *seg = new segment;
+	seg->key = key;
+	seg->all = false;
+	seg->wildcard = 0;
+	return seg;
+}
+
+JsonProjection::segment *
+JsonProjection::cloneSegment(const segment *from) {
+	segment *seg = newSegment(from->key);
+	seg->all = from->all;
+	if (from->wildcard)
+		seg->wildcard = cloneSegment(from->wildcard);
+	for (size_t i = 0; i < from->children.size(); i++)
+		seg->children.push_back(cloneSegment(from->children[i]));
+	return seg;
+}
+
+void JsonProjection::freeSegment(segment *seg) {
+	if (seg->wildcard)
+		freeSegment(seg->wildcard);
+	for (size_t i = 0; i < seg->children.size(); i++)
+		freeSegment(seg->children[i]);
+	delete seg;
+}
+
+/*
+ * Adds path[index...] below seg.  Wildcard paths are also added below
+ * every named sibling, and a new named segment starts as a copy of the
+ * wildcard, so matching never has to follow more than one segment.
+ */
+void JsonProjection::insert(segment *seg, const std::vector<std::string> &path,
+		size_t index) {
+	if (seg->all)
+		return;
+	if (index == path.size()) {
+		seg->all = true;
+		if (seg->wildcard) {
+			freeSegment(seg->wildcard);
+			seg->wildcard = 0;
+		}
+		for (size_t i = 0; i < seg->children.size(); i++)
+			freeSegment(seg->children[i]);
+		seg->children.clear();
+		return;
+	}
+	const std::string &key = path[index];
+	if (key == "*") {
+		if (!seg->wildcard)
+			seg->wildcard = newSegment(key);
+		insert(seg->wildcard, path, index + 1);
+		for (size_t i = 0; i < seg->children.size(); i++)
+			insert(seg->children[i], path, index + 1);
+		return;
+	}
+	segment *child = 0;
+	for (size_t i = 0; i < seg->children.size() && !child; i++) {
+		if (seg->children[i]->key == key)
+			child = seg->children[i];
+	}
+	if (!child) {
+		if (seg->wildcard) {
+			child = cloneSegment(seg->wildcard);
+			child->key = key;
+		} else
+			child = newSegment(key);
+		seg->children.push_back(child);
+	}
+	insert(child, path, index + 1);
+}
+
+const JsonProjection::segment *
+JsonProjection::match(const segment *seg, const std::string &key) {
+	for (size_t i = 0; i < seg->children.size(); i++) {
+		if (seg->children[i]->key == key)
+			return seg->children[i];
+	}
+	return seg->wildcard;
+}
+
+const JsonProjection::segment *
+JsonProjection::match(const segment *seg, int index) {
+	if (seg->children.empty())
+		return seg->wildcard;
+	char buf[16];
+	snprintf(buf, sizeof(buf), "%d", index);
+	return match(seg, std::string(buf));
+}
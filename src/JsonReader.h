@@ -0,0 +1,622 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __JSONREADER_H__
+#define __JSONREADER_H__
+
+#include <istream>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "JsonKey.h"
+
+/**
+ * class: JsonProjection
+ *
+ * A set of paths to keep when decoding.  Passing a projection to
+ * JsonHandle::fromString() builds only the listed subtrees, everything
+ * else is passed over by the reader's skip scanner without being
+ * decoded.
+ *
+ * Paths are keys separated by '.', a '*' matches every key of an object
+ * or every value of an array and a number selects an array index.
+ *
+ * For example:
+ *    JsonProjection keep;
+ *    keep.add("meta.source").add("items.*.id");
+ *    root.fromString(message, keep);
+ *
+ * Array values that are passed over before a selected one are kept as
+ * null so indexes do not move.
+ */
+class JsonProjection {
+	friend class _JS0;
+	friend class JsonHandle;
+	friend class JsonReader;
+public:
+	JsonProjection();
+
+	/**
+	 * Constructor - creates a projection holding a single path.
+	 */
+	explicit JsonProjection(const char *path);
+
+	JsonProjection(const JsonProjection&);
+
+	JsonProjection &operator=(const JsonProjection&);
+
+	~JsonProjection();
+
+	/**
+	 * add - adds a path to keep.  An empty path keeps everything.
+	 */
+	JsonProjection &add(const char *path);
+
+	/**
+	 * add - adds a path to keep.  An empty path keeps everything.
+	 */
+	JsonProjection &add(const std::string &path);
+
+	/**
+	 * clear - removes all paths.
+	 */
+	void clear();
+
+private:
+	struct segment {
+		std::string key;
+		bool all; // keep the whole subtree
+		segment *wildcard;
+		std::vector<segment *> children;
+	};
+
+	static segment *newSegment(const std::string &key);
+	static segment *cloneSegment(const segment *from);
+	static void freeSegment(segment *seg);
+	static void insert(segment *seg, const std::vector<std::string> &path,
+			size_t index);
+	static const segment *match(const segment *seg, const std::string &key);
+	static const segment *match(const segment *seg, int index);
+
+	segment *root;
+};
+
+class _JS0;
+
+/**
+ * struct: JsonError
+ *
+ * Describes why decoding failed and where.  Filled in by the decoding
+ * functions that take a JsonError argument, without printing anything.
+ *
+ * For example:
+ *    JsonError error;
+ *    if (root.fromString(message, error) == JsonHandle::JSON_ERROR)
+ *       reject(error.code, error.offset);
+ */
+struct JsonError {
+	enum Code {
+		NONE = 0,
+		NO_VALUE, // the input is empty or only whitespace
+		MISSING_VALUE,
+		INVALID_NULL,
+		INVALID_BOOLEAN,
+		INVALID_NUMBER,
+		INVALID_STRING,
+		INVALID_KEY,
+		KEY_NOT_STRING,
+		COLON_EXPECTED,
+		OBJECT_COMMA_EXPECTED,
+		ARRAY_COMMA_EXPECTED,
+		OBJECT_NOT_CLOSED,
+		ARRAY_NOT_CLOSED,
+		CONTAINER_NOT_CLOSED, // found while skipping
+		TRAILING_DATA, // more than one value, see JsonHandle::validate()
+		INVALID_UTF8, // see JsonParseOptions::validateUtf8
+		TOO_DEEP,
+		TOO_MANY_NODES,
+		STRING_TOO_LONG,
+		TOO_LARGE,
+		IO_ERROR, // file could not be read
+		INVALID_HANDLE // the handle cannot hold a value
+	};
+
+	Code code;
+	size_t offset; // bytes of input consumed when the error was found
+	size_t depth; // objects and arrays open when the error was found
+
+	JsonError() :
+			code(NONE), offset(0), depth(0) {
+	}
+
+	/**
+	 * message - returns a description of the error.
+	 */
+	const char *message() const {
+		return message(code);
+	}
+
+	/**
+	 * message - returns a description of an error code.
+	 */
+	static const char *message(Code code);
+};
+
+/**
+ * struct: JsonParseOptions
+ *
+ * Limits enforced by JsonReader while the input is read, so hostile or
+ * oversized documents are rejected before they are decoded.  A limit of
+ * zero means no limit, which is the default.  Strings can also be checked
+ * to be valid UTF-8; values that are skipped are not checked.
+ *
+ * With lazyNumbers, JsonHandle::fromReader() keeps the text of numbers
+ * and converts it the first time the value is asked for.  The text is
+ * written back unchanged, keeping digits a conversion would lose.
+ *
+ * With packArrays, arrays holding only integers or only doubles are kept
+ * as one buffer of numbers instead of a node each, see
+ * JsonHandle::copyTo().
+ *
+ * By default the reader accepts a few things RFC 8259 does not: a comma
+ * before a closing bracket, numbers such as 01 or 1., and unknown escape
+ * sequences, which are kept as written.  With strict these are errors, as
+ * are control characters inside strings.  JsonHandle::validate(),
+ * minify() and prettify() always read strictly.
+ *
+ * For example:
+ *    JsonParseOptions opts;
+ *    opts.maxDepth = 64;
+ *    opts.maxBytes = 1 << 20;
+ *    JsonReader r(buf, len);
+ *    r.setOptions(opts);
+ *    root.fromReader(r);
+ */
+struct JsonParseOptions {
+	size_t maxDepth; // objects and arrays open at the same time
+	size_t maxNodes; // values built by JsonHandle::fromReader()
+	size_t maxStringLength; // bytes of a decoded string or key
+	size_t maxBytes; // bytes of input
+	bool validateUtf8; // reject decoded strings and keys that are not UTF-8
+	bool lazyNumbers; // keep number text, convert on first use
+	bool packArrays; // keep arrays of only integers or only doubles packed
+	bool strict; // accept only what RFC 8259 allows
+
+	JsonParseOptions() :
+			maxDepth(0), maxNodes(0), maxStringLength(0), maxBytes(0), validateUtf8(
+					false), lazyNumbers(false), packArrays(false), strict(false) {
+	}
+};
+
+/**
+ * class: JsonReader
+ *
+ * A pull cursor over JSON text held in a buffer or read from a stream.
+ * Instead of building a JsonHandle tree, the caller walks the input one
+ * token at a time and copies out only what it needs.  Values are decoded
+ * lazily: a string or number is only converted when one of the get
+ * methods asks for it, and skipValue() passes over whole objects and
+ * arrays in a single scan.
+ *
+ * For example:
+ *    JsonReader r(buf, len);
+ *    if (r.next() == JsonReader::OBJECT && r.enterObject()) {
+ *       while (r.next() != JsonReader::END_OBJECT
+ *             && r.type() != JsonReader::INVALID) {
+ *          if (r.key() == "id")
+ *             msg.id = r.getInt64();
+ *          else
+ *             r.skipValue();
+ *       }
+ *    }
+ *
+ * The stream variant reads through the stream buffer one character at a
+ * time and never pulls characters past the end of the last value.
+ */
+class JsonReader {
+	friend class _JS0;
+	friend class JsonFrozenView;
+public:
+
+	/**
+	 * Type - the kind of token the cursor is positioned on.
+	 */
+	enum Type {
+		INVALID = 0, // syntax error, see error() and offset()
+		END, // no more input
+		NULLVALUE,
+		BOOLEAN,
+		NUMBER,
+		STRING,
+		OBJECT, // start of an object, see enterObject()
+		ARRAY, // start of an array, see enterArray()
+		END_OBJECT,
+		END_ARRAY
+	};
+
+	/**
+	 * Constructor - creates a reader with no input.  Use reset()
+	 *    to attach a buffer or a stream.
+	 */
+	JsonReader();
+
+	/**
+	 * Constructor - reads length bytes of the provided buffer.  The
+	 *    buffer must stay valid while the reader is in use.  A zero byte
+	 *    also ends the input.
+	 */
+	JsonReader(const char *buffer, size_t length);
+
+	/**
+	 * Constructor - reads the provided string.  The string must stay
+	 *    valid and unchanged while the reader is in use.
+	 */
+	explicit JsonReader(const std::string &buffer);
+
+	/**
+	 * Constructor - reads from the provided stream.
+	 */
+	explicit JsonReader(std::istream &stream);
+
+	/**
+	 * reset - restarts the reader on a new buffer.  Internal buffers are
+	 *    kept so a reader can be reused without allocating.
+	 */
+	void reset(const char *buffer, size_t length);
+
+	/**
+	 * reset - restarts the reader on a new stream.
+	 */
+	void reset(std::istream &stream);
+
+	/**
+	 * setOptions - sets the limits checked while reading.  They are kept
+	 *    across reset().
+	 */
+	void setOptions(const JsonParseOptions &options) {
+		opts = options;
+	}
+
+	/**
+	 * options - returns the limits checked while reading.
+	 */
+	const JsonParseOptions &options() const {
+		return opts;
+	}
+
+	/**
+	 * next - advances to the next token and returns its type.  Inside an
+	 *    object each value is preceded by its key, see key().  If the
+	 *    current token starts an object or array that was not skipped,
+	 *    next() steps into it.
+	 */
+	Type next();
+
+	/**
+	 * type - returns the type of the current token.
+	 */
+	Type type() const {
+		return cur;
+	}
+
+	/**
+	 * key - returns the key of the current value when it is a member of
+	 *    an object.  Otherwise the last key seen.
+	 */
+	const std::string &key() const {
+		return keyBuf;
+	}
+
+	/**
+	 * hasValue - tests if the cursor is on a value that can still be read,
+	 *    that is a scalar or an object or array that was neither entered
+	 *    nor skipped.
+	 */
+	bool hasValue() const {
+		return cur >= NULLVALUE && cur <= ARRAY && (pending || decoded);
+	}
+
+	/**
+	 * depth - returns the number of objects and arrays that have been
+	 *    entered and not yet left.
+	 */
+	int depth() const {
+		return (int) stack.size();
+	}
+
+	/**
+	 * inObject - tests if the innermost container that was entered is an
+	 *    object, in which case the current value has a key.
+	 */
+	bool inObject() const {
+		return !stack.empty() && stack.back() == '{';
+	}
+
+	/**
+	 * enterObject - steps into the object the cursor is on.  Following
+	 *    calls to next() return its members and finally END_OBJECT.
+	 * @returns
+	 *    false if the current token is not the start of an object.
+	 */
+	bool enterObject();
+
+	/**
+	 * leaveObject - skips the remaining members of the innermost object
+	 *    that was entered, including its closing brace.
+	 * @returns
+	 *    false if the innermost container is not an object or on
+	 *    syntax error.
+	 */
+	bool leaveObject();
+
+	/**
+	 * enterArray - steps into the array the cursor is on.  Following
+	 *    calls to next() return its values and finally END_ARRAY.
+	 * @returns
+	 *    false if the current token is not the start of an array.
+	 */
+	bool enterArray();
+
+	/**
+	 * leaveArray - skips the remaining values of the innermost array
+	 *    that was entered, including its closing bracket.
+	 * @returns
+	 *    false if the innermost container is not an array or on
+	 *    syntax error.
+	 */
+	bool leaveArray();
+
+	/**
+	 * skipValue - passes over the current value without decoding it.
+	 *    Objects and arrays are skipped as a whole by matching brackets
+	 *    and quotes only, so their contents are not checked in detail.
+	 * @returns
+	 *    false on syntax error.
+	 */
+	bool skipValue();
+
+	/**
+	 * nextKey - advances to the next member of the current object whose
+	 *    key is in keys, skipping the values of the others without
+	 *    decoding them.  A wanted value the caller did not read is
+	 *    skipped as well.  Use after enterObject().
+	 *
+	 *    while ((i = r.nextKey(fields)) >= 0)
+	 *       switch (i) {
+	 *       case ID: msg.id = r.getInt64(); break;
+	 *       ...
+	 *       }
+	 * @returns
+	 *    the index of the key in keys, or -1 at the end of the object and
+	 *    on syntax error, see type().
+	 */
+	int nextKey(const JsonKeySet &keys);
+
+	/**
+	 * getBoolean: gets the current boolean value.
+	 * @returns
+	 *   value or defaultValue if the current token is not a boolean.
+	 */
+	bool getBoolean(bool defaultValue = false);
+
+	/**
+	 * getInt64: gets the current number as an integer.  Decimals are
+	 *   truncated and values out of range are clamped.
+	 * @returns
+	 *   value or defaultValue if the current token is not a number.
+	 */
+	int64_t getInt64(int64_t defaultValue = 0);
+
+	/**
+	 * getUInt64: gets the current number as an unsigned integer, for
+	 *   values up to 18446744073709551615.  Decimals are truncated and
+	 *   values out of range are clamped.
+	 * @returns
+	 *   value or defaultValue if the current token is not a number.
+	 */
+	uint64_t getUInt64(uint64_t defaultValue = 0);
+
+	/**
+	 * getDouble: gets the current number as a double.
+	 * @returns
+	 *   value or defaultValue if the current token is not a number.
+	 */
+	long double getDouble(long double defaultValue = 0);
+
+	/**
+	 * getString: gets the current string value.  The reference stays
+	 *   valid until the cursor moves.
+	 * @returns
+	 *   value or an empty string if the current token is not a string.
+	 */
+	const std::string &getString();
+
+	/**
+	 * getString: decodes the current string value into the provided
+	 *   string, saving a copy when the caller keeps the value.
+	 * @returns
+	 *   false if the current token is not a string.
+	 */
+	bool getString(std::string &to);
+
+	/**
+	 * getNumberText: copies the text of the current number as it appears
+	 *   in the input, without converting it.
+	 * @returns
+	 *   false if the current token is not a number.
+	 */
+	bool getNumberText(std::string &to);
+
+	/**
+	 * isDouble - tests if the current number has a fractional part or an
+	 *    exponent.
+	 */
+	bool isDouble();
+
+	/**
+	 * isUInt64 - tests if the current number is an integer too large for
+	 *    an int64_t that fits a uint64_t.
+	 */
+	bool isUInt64();
+
+	/**
+	 * NumberKind - what convertNumber() found.  NUM_BIG is an integer
+	 *    too large for 64 bits.
+	 */
+	enum NumberKind {
+		NUM_INT64, NUM_UINT64, NUM_DOUBLE, NUM_BIG
+	};
+
+	/**
+	 * convertNumber - converts the text of a JSON number.  lng and ulng
+	 *    are clamped to their range, dbl may be rounded.
+	 * @returns
+	 *    a NumberKind.
+	 */
+	static int convertNumber(const char *s, size_t length, int64_t &lng,
+			uint64_t &ulng, long double &dbl);
+
+	/**
+	 * isValidUtf8 - tests if the bytes are well formed UTF-8, without
+	 *    overlong forms or surrogates.  Runs of ASCII are checked 16 bytes
+	 *    at a time.
+	 */
+	static bool isValidUtf8(const char *s, size_t length);
+
+	/**
+	 * error - returns a description of the syntax error when the reader
+	 *    returned INVALID, otherwise NULL.
+	 */
+	const char *error() const {
+		return (code != JsonError::NONE) ? JsonError::message(code) : 0;
+	}
+
+	/**
+	 * errorCode - returns the code of the error when the reader returned
+	 *    INVALID, otherwise JsonError::NONE.
+	 */
+	JsonError::Code errorCode() const {
+		return code;
+	}
+
+	/**
+	 * offset - returns the number of bytes consumed from the input.
+	 *    After an error, this is where the error was found.
+	 */
+	size_t offset() const {
+		return sb ? pos : (size_t) (p - begin);
+	}
+
+	/**
+	 * eof - tests if the reader has looked past the last byte of the
+	 *    input.
+	 */
+	bool eof() const {
+		return sb ? atEof : p >= end;
+	}
+
+private:
+	JsonReader(const JsonReader&);
+	JsonReader &operator=(const JsonReader&);
+
+	int peek() const {
+		if (sb) {
+			int c = sb->sgetc();
+			if (c != std::char_traits<char>::eof())
+				return c;
+			atEof = true;
+			return 0;
+		}
+		return (p < end) ? (unsigned char) *p : 0;
+	}
+
+	void advance() {
+		if (sb) {
+			sb->sbumpc();
+			pos++;
+		} else
+			p++;
+	}
+
+	/*
+	 * An object or array being built by _JS0::setFromReader().
+	 */
+	struct frame {
+		_JS0 *node;
+		const JsonProjection::segment *keep;
+		int index; // of the next array value
+		int skipped; // array values passed over since the last one kept
+	};
+
+	void skipWhiteSpace();
+	Type fail(JsonError::Code error);
+	Type startValue(int c);
+	bool finishValue();
+	bool parseString(std::string &to);
+	bool parseEscape(std::string &to, size_t limit);
+	bool parseHex4(unsigned &code);
+	bool appendCode(std::string &to, unsigned code, size_t limit);
+	static void appendUtf8(std::string &to, unsigned code);
+	bool closeString(const std::string &to);
+	bool skipString();
+	bool scanNumber();
+	static int64_t clampInt64(long double value);
+	static uint64_t clampUInt64(long double value);
+	bool decodeNumber(bool convert);
+	bool parseLiteral(const char *literal);
+	bool skipContainer(int depth);
+
+	const char *begin;
+	const char *p;
+	const char *end;
+	std::streambuf *sb;
+	size_t pos;
+	mutable bool atEof;
+
+	JsonParseOptions opts;
+	Type cur;
+	bool pending; // current value's bytes have not been consumed
+	bool decoded; // current scalar value has been decoded
+	bool first; // next token is the first one in its container
+	bool dbl;
+	bool converted; // current number's text has been converted
+
+	std::vector<char> stack;
+	std::vector<frame> frames; // kept to be reused by the next parse
+	std::string keyBuf;
+	std::string strBuf;
+	const char *numText; // current number, in the input or numBuf
+	size_t numLength;
+	std::string numBuf;
+	int numKind;
+	int64_t lngValue;
+	uint64_t ulngValue;
+	long double dblValue;
+	bool booValue;
+
+	JsonError::Code code;
+};
+
+#endif /* __JSONREADER_H__ */
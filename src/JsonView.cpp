@@ -0,0 +1,197 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "JsonView.h"
+#include "_JS0.h"
+#include <string>
+#include <vector>
+
+static const std::string EMPTY_STRING;
+
+bool JsonView::isNull() const {
+	return type() == _JS0::NULLVALUE;
+}
+
+bool JsonView::isArray() const {
+	return type() == _JS0::ARRAY;
+}
+
+bool JsonView::isObject() const {
+	return type() == _JS0::OBJECT;
+}
+
+bool JsonView::isString() const {
+	return type() == _JS0::STRING;
+}
+
+bool JsonView::isNumber() const {
+	int t = type();
+	return t == _JS0::NUMBER_LONG || t == _JS0::NUMBER_DOUBLE
+			|| t == _JS0::NUMBER_ULONG;
+}
+
+bool JsonView::isBoolean() const {
+	return type() == _JS0::BOOLEAN;
+}
+
+JsonView JsonView::operator[](int index) const {
+	const _JS0 *n = node();
+	if (!n)
+		return JsonView();
+	if (n->packed)
+		return (index >= 0 && index < n->length()) ?
+				JsonView(n, index) : JsonView();
+	return JsonView(n->getByIndex(index));
+}
+
+JsonView JsonView::operator[](const char *key) const {
+	const _JS0 *n = node();
+	return JsonView(n && key ? n->getByKey(key) : 0);
+}
+
+JsonView JsonView::operator[](std::string const &key) const {
+	const _JS0 *n = node();
+	return JsonView(n ? n->getByKey(key) : 0);
+}
+
+JsonView JsonView::operator[](JsonKey const &key) const {
+	const _JS0 *n = node();
+	return JsonView(n ? n->getByKey(key) : 0);
+}
+
+const std::string &
+JsonView::key(int index) const {
+	const _JS0 *n = node();
+	if (n && n->type == _JS0::OBJECT && index >= 0
+			&& index < (int) n->value.obj->size())
+		return n->value.obj->at(index)->key;
+	return EMPTY_STRING;
+}
+
+bool JsonView::exists(const char *key) const {
+	const _JS0 *n = node();
+	return n && key && n->getByKey(key) != 0;
+}
+
+bool JsonView::exists(std::string const &key) const {
+	const _JS0 *n = node();
+	return n && n->getByKey(key) != 0;
+}
+
+bool JsonView::exists(JsonKey const &key) const {
+	const _JS0 *n = node();
+	return n && n->getByKey(key) != 0;
+}
+
+int JsonView::extract(const JsonKeySet &keys, JsonView values[]) const {
+	int count = keys.size();
+	for (int i = 0; i < count; i++)
+		values[i] = JsonView();
+	const _JS0 *n = node();
+	if (!n || n->type != _JS0::OBJECT)
+		return 0;
+	int found = 0;
+	const std::vector<_JS0::entry *> &obj = *n->value.obj;
+	for (size_t i = 0; i < obj.size(); i++) {
+		const _JS0::entry *e = obj[i];
+		int k = keys.find(e->key.data(), e->key.length(), e->hash);
+		if (k >= 0) {
+			if (!values[k].isDefined())
+				found++;
+			values[k] = JsonView(e->node);
+		}
+	}
+	return found;
+}
+
+int JsonView::size() const {
+	const _JS0 *n = node();
+	return n ? n->length() : 0;
+}
+
+size_t JsonView::copyTo(double *values, size_t count) const {
+	const _JS0 *n = node();
+	return n ? n->copyTo(values, count) : 0;
+}
+
+size_t JsonView::copyTo(int64_t *values, size_t count) const {
+	const _JS0 *n = node();
+	return n ? n->copyTo(values, count) : 0;
+}
+
+bool JsonView::booleanValue(bool defaultValue) const {
+	if (ref & TAG)
+		return longValue() ? true : false;
+	const _JS0 *n = node();
+	if (n) {
+		if (n->type == _JS0::BOOLEAN)
+			return n->booleanValue();
+		if (n->isNumber())
+			return n->longValue() ? true : false;
+	}
+	return defaultValue;
+}
+
+int64_t JsonView::longValue(int64_t defaultValue) const {
+	if (const int64_t *l = longMember())
+		return *l;
+	if (const long double *d = doubleMember())
+		return _JS0::packedArray::toLong(*d);
+	const _JS0 *n = node();
+	return (n && (n->isNumber() || n->type == _JS0::BOOLEAN)) ?
+			n->longValue() : defaultValue;
+}
+
+uint64_t JsonView::ulongValue(uint64_t defaultValue) const {
+	if (const int64_t *l = longMember())
+		return _JS0::packedArray::toULong(*l);
+	if (const long double *d = doubleMember())
+		return _JS0::packedArray::toULong(*d);
+	const _JS0 *n = node();
+	return (n && (n->isNumber() || n->type == _JS0::BOOLEAN)) ?
+			n->ulongValue() : defaultValue;
+}
+
+long double JsonView::doubleValue(long double defaultValue) const {
+	if (const int64_t *l = longMember())
+		return (long double) *l;
+	if (const long double *d = doubleMember())
+		return *d;
+	const _JS0 *n = node();
+	return (n && (n->isNumber() || n->type == _JS0::BOOLEAN)) ?
+			n->doubleValue() : defaultValue;
+}
+
+const std::string &
+JsonView::stringValue() const {
+	const _JS0 *n = node();
+	return (n && n->type == _JS0::STRING) ? *n->value.str : EMPTY_STRING;
+}
+
+const char *
+JsonView::stringValuePtr(const char *defaultValue) const {
+	const _JS0 *n = node();
+	return (n && n->type == _JS0::STRING) ?
+			n->value.str->c_str() : defaultValue;
+}
@@ -0,0 +1,615 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2010,2011 Thomas Davis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef __JSONVIEW_H__
+#define __JSONVIEW_H__
+
+#include <iterator>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include "JsonKey.h"
+#include "_JS0.h"
+
+/**
+ * class: JsonView
+ *
+ * A read only look at data owned by a JsonHandle.  A view is a single
+ * pointer: copying it, indexing it and reading values never allocates
+ * and never touches reference counts, so chains like view["a"]["b"][3]
+ * cost only the lookups.  The members of a packed array are read in
+ * place, see JsonParseOptions::packArrays.  Numbers
+ * read with lazyNumbers are converted in their node when first read, so
+ * only documents without them can be read from several threads at
+ * once.
+ *
+ * For example:
+ *    JsonView v = root;
+ *    for (int i = 0; i < v["items"].size(); i++)
+ *       total += v["items"][i]["price"].doubleValue();
+ *
+ * Arrays and objects can also be walked with iterators, which step
+ * through the node's own storage like a std::vector iterator:
+ *    for (JsonView::iterator i = v.begin(); i != v.end(); ++i)
+ *       print((*i).stringValue());
+ *    for (auto item : v.items())        // C++11
+ *       print(item.key, item.value);
+ *
+ * A view does not keep the data alive.  It is valid as long as the
+ * handle it came from, and its part of the tree, are not changed or
+ * released.  Missing keys and indexes give an undefined view, which
+ * returns defaults from every getter.
+ */
+class JsonView {
+	friend class JsonHandle;
+	friend class JsonPath;
+	friend class JsonFrozen;
+public:
+
+	/**
+	 * Constructor - creates an undefined view.
+	 */
+	JsonView() :
+			ref(0) {
+	}
+
+	/**
+	 * isDefined - tests if the view refers to actual data.  Note that
+	 *    Null is a defined type.
+	 */
+	bool isDefined() const {
+		return ref != 0;
+	}
+
+	/**
+	 * isNull - tests if the current data is of type Null.
+	 */
+	bool isNull() const;
+
+	/**
+	 * isArray - tests if the current data is of type Array.
+	 */
+	bool isArray() const;
+
+	/**
+	 * isObject - tests if the current data is of type Object.
+	 */
+	bool isObject() const;
+
+	/**
+	 * isString - tests if the current data is of type String.
+	 */
+	bool isString() const;
+
+	/**
+	 * isNumber - tests if the current data is of type Number.
+	 */
+	bool isNumber() const;
+
+	/**
+	 * isBoolean - tests if the current data is of type Boolean.
+	 */
+	bool isBoolean() const;
+
+	/**
+	 * operator[](int) - the value at index of an array or object.
+	 */
+	JsonView operator[](int index) const;
+
+	/**
+	 * operator[](char *) - the value at key of an object.
+	 */
+	JsonView operator[](const char *key) const;
+
+	/**
+	 * operator[](std::string &) - the value at key of an object.
+	 */
+	JsonView operator[](std::string const &key) const;
+
+	/**
+	 * operator[](JsonKey &) - the value at key of an object, comparing
+	 *    hashes before keys.
+	 */
+	JsonView operator[](JsonKey const &key) const;
+
+	/**
+	 * at(int) - Same as operator[int]
+	 */
+	JsonView at(int index) const {
+		return (*this)[index];
+	}
+
+	/**
+	 * at(char *) - Same as operator[char *]
+	 */
+	JsonView at(const char *key) const {
+		return (*this)[key];
+	}
+
+	/**
+	 * at(string &) - Same as operator[string &]
+	 */
+	JsonView at(std::string const &key) const {
+		return (*this)[key];
+	}
+
+	/**
+	 * at(JsonKey &) - Same as operator[JsonKey &]
+	 */
+	JsonView at(JsonKey const &key) const {
+		return (*this)[key];
+	}
+
+	/**
+	 * key - returns the object's key at the specified index.  Only
+	 * valid for object types.
+	 */
+	const std::string &key(int index) const;
+
+	/**
+	 * exists - checks whether a specific key is present.
+	 */
+	bool exists(const char *key) const;
+
+	/**
+	 * exists - checks whether a specific key is present.
+	 */
+	bool exists(std::string const &key) const;
+
+	/**
+	 * exists - checks whether a specific key is present.
+	 */
+	bool exists(JsonKey const &key) const;
+
+	/**
+	 * extract - looks up all the keys of an object in a single pass over
+	 *   its members.  values[i] is set to the value at keys.key(i), or to
+	 *   an undefined view when the key is missing.  When a key appears
+	 *   more than once the last one is used, as with operator[].
+	 * @returns
+	 *   the number of keys found.
+	 */
+	int extract(const JsonKeySet &keys, JsonView values[]) const;
+
+	/**
+	 * size()
+	 *    if view is an Array - size of array.
+	 *    if view is an Object - number of object properties.
+	 *    otherwise 0
+	 */
+	int size() const;
+
+	/**
+	 * booleanValue: gets the boolean value.  Numbers are true when
+	 *   not zero.  Unlike JsonHandle strings are not converted, as
+	 *   that would allocate.
+	 * @returns
+	 *   value or defaultValue.
+	 */
+	bool booleanValue(bool defaultValue = false) const;
+
+	/**
+	 * longValue: gets the long value of a number or boolean.  Numbers
+	 *   out of range are clamped.
+	 * @returns
+	 *   value or defaultValue.
+	 */
+	int64_t longValue(int64_t defaultValue = 0) const;
+
+	/**
+	 * ulongValue: gets the unsigned long value of a number or boolean.
+	 *   Numbers out of range are clamped.
+	 * @returns
+	 *   value or defaultValue.
+	 */
+	uint64_t ulongValue(uint64_t defaultValue = 0) const;
+
+	/**
+	 * doubleValue: gets the double value of a number or boolean.
+	 * @returns
+	 *   value or defaultValue.
+	 */
+	long double doubleValue(long double defaultValue = 0) const;
+
+	/**
+	 * stringValue: gets the string value.  Numbers and booleans are
+	 *   not converted.
+	 * @returns
+	 *   value or an empty string.
+	 */
+	const std::string &stringValue() const;
+
+	/**
+	 * stringValuePtr: gets the string value.  Numbers and booleans are
+	 *   not converted.
+	 * @returns
+	 *   value or defaultValue.
+	 */
+	const char *stringValuePtr(const char *defaultValue = NULL) const;
+
+	/**
+	 * copyTo: copies the first count members of an array as doubles,
+	 *   without making nodes for a packed one.  Members that are not
+	 *   numbers or booleans give 0.
+	 * @returns
+	 *   the number copied, fewer when the array is shorter.
+	 */
+	size_t copyTo(double *values, size_t count) const;
+
+	/**
+	 * copyTo: as above, as integers clamped like longValue().
+	 */
+	size_t copyTo(int64_t *values, size_t count) const;
+
+	/**
+	 * iterator - random access over the values of an array or object,
+	 *    in order.  Dereferencing gives a JsonView.
+	 */
+	class iterator {
+		friend class JsonView;
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef JsonView value_type;
+		typedef ptrdiff_t difference_type;
+		typedef void pointer;
+		typedef JsonView reference;
+
+		iterator() :
+				keyed(false), array(0) {
+			p.arr = 0;
+		}
+
+		JsonView operator*() const {
+			if (array)
+				return JsonView(array, (int) p.index);
+			return JsonView(keyed ? (*p.obj)->node : *p.arr);
+		}
+
+		JsonView operator[](difference_type n) const {
+			return *(*this + n);
+		}
+
+		iterator &operator+=(difference_type n) {
+			if (array)
+				p.index += n;
+			else if (keyed)
+				p.obj += n;
+			else
+				p.arr += n;
+			return *this;
+		}
+
+		iterator &operator-=(difference_type n) {
+			return *this += -n;
+		}
+
+		iterator &operator++() {
+			return *this += 1;
+		}
+
+		iterator &operator--() {
+			return *this += -1;
+		}
+
+		iterator operator++(int) {
+			iterator i(*this);
+			*this += 1;
+			return i;
+		}
+
+		iterator operator--(int) {
+			iterator i(*this);
+			*this += -1;
+			return i;
+		}
+
+		iterator operator+(difference_type n) const {
+			iterator i(*this);
+			return i += n;
+		}
+
+		iterator operator-(difference_type n) const {
+			iterator i(*this);
+			return i += -n;
+		}
+
+		difference_type operator-(const iterator &other) const {
+			return array ? p.index - other.p.index :
+					keyed ? p.obj - other.p.obj : p.arr - other.p.arr;
+		}
+
+		bool operator==(const iterator &other) const {
+			return array ? p.index == other.p.index :
+					keyed ? p.obj == other.p.obj : p.arr == other.p.arr;
+		}
+
+		bool operator!=(const iterator &other) const {
+			return !(*this == other);
+		}
+
+		bool operator<(const iterator &other) const {
+			return (*this - other) < 0;
+		}
+
+		bool operator>(const iterator &other) const {
+			return (*this - other) > 0;
+		}
+
+		bool operator<=(const iterator &other) const {
+			return (*this - other) <= 0;
+		}
+
+		bool operator>=(const iterator &other) const {
+			return (*this - other) >= 0;
+		}
+
+	private:
+		union {
+			_JS0 * const *arr;
+			_JS0::entry * const *obj;
+			difference_type index; // into array
+		} p;
+		bool keyed;
+		const _JS0 *array; // a packed array, its members have no nodes
+	};
+
+	typedef iterator const_iterator;
+
+	/**
+	 * item - a key and value of an object, see items().
+	 */
+	struct item;
+
+	/**
+	 * item_iterator - random access over the members of an object.
+	 *    Dereferencing gives an item.
+	 */
+	class item_iterator {
+		friend class JsonView;
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef item value_type;
+		typedef ptrdiff_t difference_type;
+		typedef void pointer;
+		typedef item reference;
+
+		item_iterator() :
+				p(0) {
+		}
+
+		item operator*() const;
+
+		item operator[](difference_type n) const;
+
+		item_iterator &operator+=(difference_type n) {
+			p += n;
+			return *this;
+		}
+
+		item_iterator &operator-=(difference_type n) {
+			p -= n;
+			return *this;
+		}
+
+		item_iterator &operator++() {
+			++p;
+			return *this;
+		}
+
+		item_iterator &operator--() {
+			--p;
+			return *this;
+		}
+
+		item_iterator operator++(int) {
+			item_iterator i(*this);
+			++p;
+			return i;
+		}
+
+		item_iterator operator--(int) {
+			item_iterator i(*this);
+			--p;
+			return i;
+		}
+
+		item_iterator operator+(difference_type n) const {
+			item_iterator i(*this);
+			return i += n;
+		}
+
+		item_iterator operator-(difference_type n) const {
+			item_iterator i(*this);
+			return i -= n;
+		}
+
+		difference_type operator-(const item_iterator &other) const {
+			return p - other.p;
+		}
+
+		bool operator==(const item_iterator &other) const {
+			return p == other.p;
+		}
+
+		bool operator!=(const item_iterator &other) const {
+			return p != other.p;
+		}
+
+		bool operator<(const item_iterator &other) const {
+			return p < other.p;
+		}
+
+		bool operator>(const item_iterator &other) const {
+			return p > other.p;
+		}
+
+		bool operator<=(const item_iterator &other) const {
+			return p <= other.p;
+		}
+
+		bool operator>=(const item_iterator &other) const {
+			return p >= other.p;
+		}
+
+	private:
+		_JS0::entry * const *p;
+	};
+
+	/**
+	 * item_range - what items() returns, for use with range for.
+	 */
+	struct item_range {
+		item_iterator first;
+		item_iterator last;
+
+		item_iterator begin() const {
+			return first;
+		}
+
+		item_iterator end() const {
+			return last;
+		}
+	};
+
+	/**
+	 * begin, end - iterators over the values of an array or object.
+	 *    Both are equal for other types.
+	 */
+	iterator begin() const {
+		return bounds(false);
+	}
+
+	iterator end() const {
+		return bounds(true);
+	}
+
+	/**
+	 * items - the key and value pairs of an object.  Empty for other
+	 *    types.
+	 */
+	item_range items() const {
+		item_range r;
+		const _JS0 *n = node();
+		if (n && n->type == _JS0::OBJECT && !n->value.obj->empty()) {
+			r.first.p = &n->value.obj->front();
+			r.last.p = r.first.p + n->value.obj->size();
+		}
+		return r;
+	}
+
+	/**
+	 * operator == - true when both views refer to the same data.
+	 */
+	bool operator ==(const JsonView &other) const {
+		return ref == other.ref;
+	}
+
+	bool operator !=(const JsonView &other) const {
+		return !(*this == other);
+	}
+
+private:
+	// members of a packed array have no node, a view of one points at the
+	// number itself and keeps its kind in the low bits, which are clear in
+	// any pointer to a node, an int64_t or a long double
+	enum {
+		LONG_MEMBER = 1, DOUBLE_MEMBER = 2, TAG = 3
+	};
+
+	explicit JsonView(const _JS0 *node) :
+			ref((uintptr_t) node) {
+	}
+
+	// member index of the packed array node
+	JsonView(const _JS0 *node, int index) {
+		const _JS0::packedArray *p = node->value.pack;
+		ref = (p->type == _JS0::NUMBER_LONG) ?
+				(uintptr_t) &p->lng[index] | LONG_MEMBER :
+				(uintptr_t) &p->dbl[index] | DOUBLE_MEMBER;
+	}
+
+	const _JS0 *node() const {
+		return (ref & TAG) ? 0 : (const _JS0 *) ref;
+	}
+
+	const int64_t *longMember() const {
+		return ((ref & TAG) == LONG_MEMBER) ?
+				(const int64_t *) (ref & ~(uintptr_t) TAG) : 0;
+	}
+
+	const long double *doubleMember() const {
+		return ((ref & TAG) == DOUBLE_MEMBER) ?
+				(const long double *) (ref & ~(uintptr_t) TAG) : 0;
+	}
+
+	// the type of the value, NUMBER_LONG or NUMBER_DOUBLE for a member
+	int type() const {
+		switch (ref & TAG) {
+		case LONG_MEMBER:
+			return _JS0::NUMBER_LONG;
+		case DOUBLE_MEMBER:
+			return _JS0::NUMBER_DOUBLE;
+		default:
+			return ref ? node()->type : _JS0::UNDEFINED;
+		}
+	}
+
+	iterator bounds(bool end) const {
+		iterator i;
+		const _JS0 *n = node();
+		if (n && n->packed) {
+			i.array = n;
+			i.p.index = end ? n->length() : 0;
+		} else if (n && n->type == _JS0::ARRAY && !n->value.arr->empty()) {
+			i.p.arr = &n->value.arr->front();
+			if (end)
+				i.p.arr += n->value.arr->size();
+		} else if (n && n->type == _JS0::OBJECT && !n->value.obj->empty()) {
+			i.p.obj = &n->value.obj->front();
+			i.keyed = true;
+			if (end)
+				i.p.obj += n->value.obj->size();
+		}
+		return i;
+	}
+
+	uintptr_t ref;
+};
+
+struct JsonView::item {
+	const std::string &key;
+	JsonView value;
+};
+
+inline JsonView::item JsonView::item_iterator::operator*() const {
+	item i = { (*p)->key, JsonView((*p)->node) };
+	return i;
+}
+
+inline JsonView::item JsonView::item_iterator::operator[](
+		difference_type n) const {
+	return *(*this + n);
+}
+
+#endif /* __JSONVIEW_H__ */
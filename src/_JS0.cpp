@@ -23,10 +23,20 @@
  */
 
 #include "_JS0.h"
+#include "JsonHandle.h"
 #include <string>
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <new>
+#include <utility>
 #include <stdio.h>
+#include <stdlib.h>
+#ifdef HAS_JSON_THREADS
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#endif
 
 #ifdef _WIN32
 #define snprintf _snprintf
@@ -39,30 +49,74 @@ static const char indentBuffer[] =
 #define MAX_INDENT ((int)sizeof(indentBuffer)-2)
 #define INDENT(s,n)  s.append(indentBuffer,1 + (((n) < MAX_INDENT) ? (n) : MAX_INDENT))
 
-#define PRINTERR(foo,msg) fprintf(stderr,"_JS0::%s: %s\n", foo, msg)
-
-#define HEX(c) ((c >= '0' && c <= '9') ? (c - '0') : (c >= 'a' && c <= 'f') ? ((c - 'a') + 10) : (c >= 'A' && c <= 'F') ? ((c - 'F') + 10) :  -1)
+#define PRINTERR(foo,msg) (JsonHandle::errorFunction ? JsonHandle::errorFunction(foo, msg) : (void) 0)
 
 #ifdef HAS_JSON_STATS
 struct _JS0::stats _JS0::stats;
 #endif
 
+/*
+ * Frees what nothing but the walked tree holds without recursing through
+ * each child's destructor.  Members are removed and unlinked as they are
+ * reached, so an array or object is empty when it is closed and
+ * destroying it frees no further.
+ */
+struct _JS0::treeFreer {
+	const _JS0 *root; // reset, not destroyed
+
+	bool open(const _JS0 *, size_t) {
+		return true;
+	}
+
+	// taken from the end, the walk counts members by itself
+	const _JS0 *member(const _JS0 *node, size_t, size_t) {
+		_JS0 *child;
+		if (node->type == OBJECT) {
+			entry *e = node->value.obj->back();
+			node->value.obj->pop_back();
+			child = e->node;
+			freeEntry(e);
+		} else {
+			child = node->value.arr->back();
+			node->value.arr->pop_back();
+		}
+		if (!child->unlinkLast())
+			return 0;
+		// with deferredFree destroy() queues it instead
+		if ((child->type == OBJECT || child->type == ARRAY) && !child->packed
+				&& child->length() > 0 && !JsonHandle::deferredFree)
+			return child;
+		child->destroy();
+		return 0;
+	}
+
+	void close(const _JS0 *node, size_t) {
+		if (node != root)
+			const_cast<_JS0 *>(node)->destroy();
+	}
+
+	void leaf(const _JS0 *, size_t) {
+	}
+};
+
 void _JS0::reset() {
 	if (type != _JS0::UNDEFINED) {
 		switch (type) {
-		case _JS0::OBJECT: {
-			for (int i = value.obj->size() - 1; i >= 0; i--) {
-				struct entry *e = value.obj->at(i);
-				e->node->release();
-				delete e;
-			}
-			delete value.obj;
-		}
-			break;
+		case _JS0::OBJECT:
 		case _JS0::ARRAY: {
-			for (int i = value.arr->size() - 1; i >= 0; i--)
-				value.arr->at(i)->release();
-			delete value.arr;
+			if (packed) {
+				delete value.pack;
+				packed = false;
+				break;
+			}
+			if (length() > 0) {
+				treeFreer freer = { this };
+				walk(this, freer);
+			}
+			if (type == _JS0::OBJECT)
+				delete value.obj;
+			else
+				delete value.arr;
 		}
 			break;
 		case _JS0::STRING:
@@ -75,20 +129,11 @@ void _JS0::reset() {
 	}
 }
 
-int _JS0::length() const {
-	switch (type) {
-	case _JS0::OBJECT:
-		return value.obj->size();
-	case _JS0::ARRAY:
-		return value.arr->size();
-	default:
-		return 0;
-	}
-}
-
 _JS0 *
 _JS0::getByIndex(int index) const {
 	if (type == _JS0::ARRAY) {
+		if (packed) // its members have no nodes
+			return (_JS0 *) 0;
 		if (index >= 0 && index < (int) value.arr->size())
 			return value.arr->at(index);
 	} else if (type == _JS0::OBJECT) {
@@ -122,19 +167,48 @@ _JS0::getByKey(const char *key) const {
 	return (_JS0 *) 0;
 }
 
+_JS0 *
+_JS0::getByKey(const JsonKey &key) const {
+	if (type == _JS0::OBJECT) {
+		for (int i = value.obj->size() - 1; i >= 0; i--) {
+			struct entry *e = value.obj->at(i);
+			if (e->hash == key.hashValue() && e->key.length() == key.length()
+					&& e->key.compare(0, key.length(), key.data(),
+							key.length()) == 0)
+				return e->node;
+		}
+	}
+	return (_JS0 *) 0;
+}
+
 bool _JS0::booleanValue() const {
 	return value.boo;
 }
 
 int64_t _JS0::longValue() const {
+	if (aux && (aux->flags & (RAW_NUMBER | RAW_DECODED)) == RAW_NUMBER)
+		decodeRawNumber();
 	return (type == _JS0::NUMBER_LONG) ? value.lng :
-			(type == _JS0::NUMBER_DOUBLE) ? (int64_t) value.dbl :
+			(type == _JS0::NUMBER_DOUBLE) ? JsonReader::clampInt64(value.dbl) :
+			(type == _JS0::NUMBER_ULONG) ? JsonReader::clampInt64(value.ulng) :
+			(type == _JS0::BOOLEAN && value.boo) ? 1 : 0;
+}
+
+uint64_t _JS0::ulongValue() const {
+	if (aux && (aux->flags & (RAW_NUMBER | RAW_DECODED)) == RAW_NUMBER)
+		decodeRawNumber();
+	return (type == _JS0::NUMBER_ULONG) ? value.ulng :
+			(type == _JS0::NUMBER_LONG) ? (value.lng < 0 ? 0 : value.lng) :
+			(type == _JS0::NUMBER_DOUBLE) ? JsonReader::clampUInt64(value.dbl) :
 			(type == _JS0::BOOLEAN && value.boo) ? 1 : 0;
 }
 
 long double _JS0::doubleValue() const {
+	if (aux && (aux->flags & (RAW_NUMBER | RAW_DECODED)) == RAW_NUMBER)
+		decodeRawNumber();
 	return (type == _JS0::NUMBER_DOUBLE) ? value.dbl :
 			(type == _JS0::NUMBER_LONG) ? (long double) value.lng :
+			(type == _JS0::NUMBER_ULONG) ? (long double) value.ulng :
 			(type == _JS0::BOOLEAN && value.boo) ? 1 : 0;
 }
 
@@ -152,54 +226,442 @@ _JS0::stringValue() const {
 	return (type == _JS0::STRING) ? *value.str : *(std::string*) 0;
 }
 
-_JS0 *
-_JS0::clone() const {
-	_JS0 *node = new _JS0();
-	node->setType(type);
-	switch (type) {
-	case _JS0::NUMBER_LONG:
-		node->value.lng = value.lng;
-		break;
-	case _JS0::NUMBER_DOUBLE:
-		node->value.dbl = value.dbl;
-		break;
-	case _JS0::BOOLEAN:
-		node->value.boo = value.boo;
-		break;
-	case _JS0::STRING:
-		*(node->value.str) = *value.str;
-		break;
-	case _JS0::OBJECT: {
-		int len = value.obj->size();
-		for (int i = 0; i < len; i++) {
-			struct entry *ae = value.obj->at(i);
-			struct entry *be = new struct entry;
-			be->key = ae->key;
-			be->node = ae->node->clone();
-			be->node->reserve();
-			node->value.obj->push_back(be);
+/*
+ * Memory for the nodes and entries of a large copy, taken in segments of
+ * up to SEGMENT chunks, each a single malloc() cut into BLOCK_SIZE chunks
+ * aligned to BLOCK_SIZE.  Each chunk starts with a header so the first
+ * chunk of its segment, which counts the objects still alive, can be found
+ * from the address of any object.  A segment is freed when its last object
+ * is released.
+ */
+struct _JS0::block {
+	block *first;
+#ifdef HAS_JSON_THREADS
+	std::atomic<size_t> live; // in first only
+#else
+	size_t live; // in first only
+#endif
+	void *memory; // in first only
+};
+
+static const size_t BLOCK_SIZE = 64 * 1024;
+static const size_t BLOCK_HEADER = 32; // sizeof(block), keeping 16 alignment
+static const size_t SEGMENT = 16; // chunks, small enough for malloc to reuse
+static const size_t BULK_MIN = 4096; // smaller copies use new
+
+// bump allocator over the chunks of the segments of a copy
+struct _JS0::blockCursor {
+	// each chunk can lose the size of an object at its end
+	static const size_t USABLE = BLOCK_SIZE - BLOCK_HEADER - sizeof(entry);
+
+	char *next;
+	char *limit;
+	char *end;
+	block *first;
+	size_t chunks; // not yet taken
+
+	blockCursor(size_t bytes) :
+			next(0), limit(0), end(0), first(0),
+			chunks(bytes / USABLE + (bytes % USABLE != 0)) {
+	}
+
+	void *allocate(size_t size) {
+		if (next + size > limit) {
+			if (limit == end && !grow())
+				return 0;
+			block *b = (block *) limit;
+			b->first = first;
+			next = limit + BLOCK_HEADER;
+			limit += BLOCK_SIZE;
 		}
-		break;
+		void *p = next;
+		next += (size + 15) & ~(size_t) 15;
+#ifdef HAS_JSON_THREADS
+		first->live.fetch_add(1, std::memory_order_relaxed);
+#else
+		first->live++;
+#endif
+		return p;
 	}
-	case _JS0::ARRAY: {
-		int len = value.arr->size();
-		for (int i = 0; i < len; i++) {
-			_JS0 *n = value.arr->at(i)->clone();
-			n->reserve();
-			node->value.arr->push_back(n);
+
+	bool grow() {
+		size_t n = chunks < SEGMENT ? chunks : SEGMENT;
+		void *memory = n ? malloc((n + 1) * BLOCK_SIZE) : 0;
+		if (!memory) {
+			chunks = 0;
+			return false;
 		}
-		break;
+		chunks -= n;
+		next = limit = (char *) (((uintptr_t) memory + BLOCK_SIZE - 1)
+				& ~(uintptr_t) (BLOCK_SIZE - 1));
+		end = limit + n * BLOCK_SIZE;
+		first = new (limit) block;
+		first->live = 0;
+		first->memory = memory;
+		return true;
+	}
+};
+
+void _JS0::releaseBlock(void *object) {
+	block *b = ((block *) ((uintptr_t) object & ~(uintptr_t) (BLOCK_SIZE - 1)))->first;
+#ifdef HAS_JSON_THREADS
+	if (b->live.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		free(b->memory);
+#else
+	if (--b->live == 0)
+		free(b->memory);
+#endif
+}
+
+std::vector<_JS0 *> _JS0::deferred;
+
+#ifdef HAS_JSON_THREADS
+static std::mutex deferredLock; // guards deferred and the reclaimer
+static std::condition_variable deferredReady;
+static std::thread *reclaimer = 0; // a pointer, exit must not destroy it
+static bool reclaimerStop = false;
+#endif
+
+void _JS0::destroy() {
+	if (JsonHandle::deferredFree && (type == OBJECT || type == ARRAY)
+			&& !packed && length() > 0) {
+#ifdef HAS_JSON_THREADS
+		bool wake;
+		{
+			std::lock_guard<std::mutex> lock(deferredLock);
+			wake = deferred.empty();
+			deferred.push_back(this);
+		}
+		if (wake)
+			deferredReady.notify_one();
+#else
+		deferred.push_back(this);
+#endif
+		return;
+	}
+	if (bulk) {
+		this->~_JS0();
+		releaseBlock(this);
+	} else
+		delete this;
+}
+
+void _JS0::freeEntry(entry *e) {
+	if (e->bulk) {
+		e->~entry();
+		releaseBlock(e);
+	} else
+		delete e;
+}
+
+/*
+ * Frees the queued arrays and objects, visiting at most budget nodes.
+ * Children are taken from the end of their container one at a time, and
+ * those that are arrays or objects themselves go on a stack instead of
+ * being freed recursively, so a large tree is freed in as many slices as
+ * needed.  What is left is queued again for the next call.
+ */
+size_t _JS0::reclaim(size_t budget) {
+	std::vector<_JS0 *> work;
+	{
+#ifdef HAS_JSON_THREADS
+		std::lock_guard<std::mutex> lock(deferredLock);
+#endif
+		work.swap(deferred);
+	}
+	size_t visited = 0;
+	while (!work.empty() && visited < budget) {
+		_JS0 *node = work.back();
+		visited++;
+		if (node->length() == 0) {
+			work.pop_back();
+			node->destroy();
+			continue;
+		}
+		_JS0 *child;
+		if (node->type == OBJECT) {
+			entry *e = node->value.obj->back();
+			node->value.obj->pop_back();
+			child = e->node;
+			freeEntry(e);
+		} else {
+			child = node->value.arr->back();
+			node->value.arr->pop_back();
+		}
+		if (child->unlinkLast()) {
+			if ((child->type == OBJECT || child->type == ARRAY)
+					&& !child->packed && child->length() > 0)
+				work.push_back(child);
+			else
+				child->destroy();
+		}
+	}
+#ifdef HAS_JSON_THREADS
+	std::lock_guard<std::mutex> lock(deferredLock);
+#endif
+	deferred.insert(deferred.end(), work.begin(), work.end());
+	return deferred.size();
+}
+
+#ifdef HAS_JSON_THREADS
+void _JS0::startReclaimer() {
+	std::lock_guard<std::mutex> lock(deferredLock);
+	if (!reclaimer)
+		reclaimer = new std::thread(reclaimLoop);
+}
+
+void _JS0::stopReclaimer() {
+	std::thread *t;
+	{
+		std::lock_guard<std::mutex> lock(deferredLock);
+		t = reclaimer;
+		reclaimerStop = true;
+	}
+	deferredReady.notify_one();
+	if (t) {
+		t->join();
+		delete t;
+	}
+	{
+		std::lock_guard<std::mutex> lock(deferredLock);
+		reclaimer = 0;
+		reclaimerStop = false;
+	}
+	reclaim((size_t) -1);
+}
+
+void _JS0::reclaimLoop() {
+	std::unique_lock<std::mutex> lock(deferredLock);
+	while (!reclaimerStop) {
+		if (deferred.empty()) {
+			deferredReady.wait(lock);
+			continue;
+		}
+		lock.unlock();
+		reclaim((size_t) -1);
+		lock.lock();
+	}
+}
+#endif
+
+/*
+ * Copies the walked tree into current.  The copies of all members of an
+ * array or object are made when it is opened, so they end up next to
+ * each other.
+ */
+struct _JS0::treeCopier {
+	blockCursor &cursor;
+	std::vector<_JS0 *> copies; // of the open arrays and objects
+	_JS0 *current; // the copy of the node walked next
+
+	treeCopier(blockCursor &cursor) :
+			cursor(cursor), current(0) {
+	}
+
+	bool open(const _JS0 *node, size_t) {
+		_JS0 *to = current;
+		if (node->packed) {
+			to->setPacked(new packedArray(*node->value.pack));
+			return false;
+		}
+		to->setType(node->type);
+		if (node->type == OBJECT) {
+			const std::vector<entry *> &a = *node->value.obj;
+			std::vector<entry *> &b = *to->value.obj;
+			b.reserve(a.size());
+			for (size_t i = 0; i < a.size(); i++) {
+				void *p = cursor.allocate(sizeof(entry));
+				entry *e = p ? new (p) entry() : new entry();
+				e->bulk = p != 0;
+				e->key = a[i]->key;
+				e->hash = a[i]->hash;
+				e->node = newNode(cursor);
+				e->node->link();
+				b.push_back(e);
+			}
+		} else {
+			const std::vector<_JS0 *> &a = *node->value.arr;
+			std::vector<_JS0 *> &b = *to->value.arr;
+			b.reserve(a.size());
+			for (size_t i = 0; i < a.size(); i++) {
+				b.push_back(newNode(cursor));
+				b.back()->link();
+			}
+		}
+		if (node->aux)
+			to->aux = new extra(*node->aux);
+		copies.push_back(to);
+		return true;
+	}
+
+	const _JS0 *member(const _JS0 *node, size_t index, size_t) {
+		if (node->type == OBJECT) {
+			current = copies.back()->value.obj->at(index)->node;
+			return node->value.obj->at(index)->node;
+		}
+		current = copies.back()->value.arr->at(index);
+		return node->value.arr->at(index);
+	}
+
+	void close(const _JS0 *, size_t) {
+		copies.pop_back();
+	}
+
+	void leaf(const _JS0 *node, size_t) {
+		current->setType(node->type);
+		switch (node->type) {
+		case STRING:
+			*current->value.str = *node->value.str;
+			break;
+		case UNDEFINED:
+			break;
+		default:
+			current->value = node->value;
+			break;
+		}
+		if (node->aux)
+			current->aux = new extra(*node->aux);
+	}
+};
+
+/*
+ * Deep copies count subtrees into to, which receives unreferenced nodes
+ * and must not overlap from.  The subtrees are measured up to one
+ * segment, so small copies get a block of the right size and tiny ones
+ * none, then copied with walk(), so depth costs no recursion.
+ * Measuring a whole large tree would cost about as much as copying it.
+ */
+void _JS0::cloneTree(const _JS0 * const *from, size_t count, _JS0 **to) {
+	const size_t whole = SEGMENT * blockCursor::USABLE;
+	std::vector<const _JS0 *> todo;
+	size_t bytes = 0;
+	for (size_t i = 0; bytes < whole && (i < count || !todo.empty());) {
+		const _JS0 *n;
+		if (todo.empty())
+			n = from[i++];
+		else {
+			n = todo.back();
+			todo.pop_back();
+		}
+		bytes += sizeof(_JS0);
+		if (n->type == _JS0::OBJECT) {
+			bytes += n->value.obj->size() * ((sizeof(entry) + 15) & ~15);
+			for (size_t k = 0; k < n->value.obj->size(); k++)
+				todo.push_back(n->value.obj->at(k)->node);
+		} else if (n->type == _JS0::ARRAY && !n->packed)
+			todo.insert(todo.end(), n->value.arr->begin(), n->value.arr->end());
+	}
+	blockCursor cursor(bytes < BULK_MIN ? 0 : bytes < whole ? bytes : (size_t) -1);
+
+	treeCopier copier(cursor);
+	for (size_t i = 0; i < count; i++)
+		to[i] = newNode(cursor);
+	for (size_t i = 0; i < count; i++) {
+		copier.current = to[i];
+		walk(from[i], copier);
+	}
+}
+
+_JS0 *
+_JS0::newNode(blockCursor &cursor) {
+	void *p = cursor.allocate(sizeof(_JS0));
+	if (!p)
+		return new _JS0();
+	_JS0 *n = new (p) _JS0();
+	n->bulk = true;
+	return n;
+}
+
+_JS0 *
+_JS0::clone() const {
+	const _JS0 *from = this;
+	_JS0 *to;
+	cloneTree(&from, 1, &to);
+	return to;
+}
+
+/*
+ * Moves the value of from into this node without copying it, leaving from
+ * undefined.  Children change owner but are not touched.  from must not
+ * hold this node.
+ */
+void _JS0::take(_JS0 &from) {
+	if (&from == this)
+		return;
+	reset();
+	delete aux;
+	type = from.type;
+	packed = from.packed;
+	value = from.value;
+	aux = from.aux;
+	from.type = _JS0::UNDEFINED;
+	from.packed = false;
+	from.aux = 0;
+}
+
+/*
+ * Returns child, a member of this array or object, ready to be changed.
+ * A child that other arrays or objects also hold is replaced here by a
+ * copy sharing its own children, so only the path being changed is ever
+ * copied.
+ */
+_JS0 *
+_JS0::own(_JS0 *child) {
+	if (!child || child->links <= 1)
+		return child;
+	_JS0 **slot = 0;
+	if (type == _JS0::ARRAY) {
+		for (int i = value.arr->size() - 1; i >= 0 && !slot; i--)
+			if (value.arr->at(i) == child)
+				slot = &(*value.arr)[i];
+	} else if (type == _JS0::OBJECT) {
+		for (int i = value.obj->size() - 1; i >= 0 && !slot; i--)
+			if (value.obj->at(i)->node == child)
+				slot = &value.obj->at(i)->node;
 	}
+	if (!slot)
+		return child;
+	_JS0 *n = new _JS0();
+	n->copy(*child, true);
+	n->link();
+	*slot = n;
+	child->unlink();
+	return n;
+}
+
+/*
+ * Removes child from this array or object, wherever it is held.
+ */
+void _JS0::detach(const _JS0 *child) {
+	if (type == _JS0::ARRAY && !packed) {
+		for (int i = value.arr->size() - 1; i >= 0; i--)
+			if (value.arr->at(i) == child)
+				erase(i);
+	} else if (type == _JS0::OBJECT) {
+		for (int i = value.obj->size() - 1; i >= 0; i--)
+			if (value.obj->at(i)->node == child)
+				erase(i);
 	}
-	return node;
 }
 
-void _JS0::copy(const _JS0 &from) {
-	setType(from.type);
+/*
+ * Copies the value of from.  With share, arrays and objects get the same
+ * children as from instead of clones, see own().
+ */
+void _JS0::copy(const _JS0 &from, bool share) {
+	if (&from == this)
+		return;
+	if (from.packed)
+		setPacked(new packedArray(*from.value.pack));
+	else
+		setType(from.type);
 	switch (from.type) {
 	case _JS0::NUMBER_LONG:
 		value.lng = from.value.lng;
 		break;
+	case _JS0::NUMBER_ULONG:
+		value.ulng = from.value.ulng;
+		break;
 	case _JS0::NUMBER_DOUBLE:
 		value.dbl = from.value.dbl;
 		break;
@@ -212,145 +674,185 @@ void _JS0::copy(const _JS0 &from) {
 	case _JS0::OBJECT: {
 		int olen = value.obj->size();
 		int len = from.value.obj->size();
+		std::vector<_JS0 *> nodes(len), copies(len);
+		for (int i = 0; i < len; i++)
+			nodes[i] = from.value.obj->at(i)->node;
+		if (!share && len > 0) {
+			cloneTree(&nodes[0], len, &copies[0]);
+			nodes.swap(copies);
+		}
+		value.obj->reserve(olen + len);
 		for (int i = 0; i < len; i++) {
 			struct entry *ae = from.value.obj->at(i);
 			struct entry *be = new struct entry;
 			be->key = ae->key;
-			be->node = ae->node->clone();
-			be->node->reserve();
+			be->hash = ae->hash;
+			be->node = nodes[i];
+			be->node->link();
 			value.obj->push_back(be);
 		}
 		if (olen > 0) {
 			for (int i = 0; i < olen; i++) {
 				struct entry * e = value.obj->at(i);
-				e->node->release();
-				delete e;
+				e->node->unlink();
+				freeEntry(e);
 			}
 			value.obj->erase(value.obj->begin(), value.obj->begin() + olen);
 		}
 		break;
 	}
 	case _JS0::ARRAY: {
+		if (from.packed)
+			break;
 		int olen = value.arr->size();
 		int len = from.value.arr->size();
-		for (int i = 0; i < len; i++) {
-			_JS0 *n = from.value.arr->at(i)->clone();
-			n->reserve();
-			value.arr->push_back(n);
+		value.arr->resize(olen + len);
+		if (len > 0) {
+			if (share)
+				std::copy(from.value.arr->begin(), from.value.arr->end(),
+						value.arr->begin() + olen);
+			else
+				cloneTree(&from.value.arr->at(0), len, &value.arr->at(olen));
 		}
+		for (int i = 0; i < len; i++)
+			value.arr->at(olen + i)->link();
 		if (olen > 0) {
 			for (int i = 0; i < olen; i++) {
-				value.arr->at(i)->release();
+				value.arr->at(i)->unlink();
 			}
 			value.arr->erase(value.arr->begin(), value.arr->begin() + olen);
 		}
 		break;
 	}
 	}
+	if (from.aux)
+		aux = new extra(*from.aux);
 }
 
-void _JS0::appendJsonString(std::string &buffer, bool whiteSpace, int precision,
-		int depth) const {
-	switch (type) {
-	case _JS0::STRING:
-		quoteJsonString(*value.str, buffer);
-		break;
-	case _JS0::NUMBER_LONG:
-	case _JS0::NUMBER_DOUBLE:
-	case _JS0::BOOLEAN:
-	case _JS0::NULLVALUE:
-		appendStringValue(buffer, precision);
-		break;
-	case _JS0::OBJECT: {
-		buffer.push_back('{');
-		int len = value.obj->size();
-		for (int i = 0; i < len; i++) {
-			struct entry *e = value.obj->at(i);
-			if (i > 0)
-				buffer.push_back(',');
-			if (whiteSpace)
-				INDENT(buffer, depth+1);
+/*
+ * Encodes the walked tree into buffer, see appendJsonString().
+ */
+struct _JS0::treeWriter {
+	std::string &buffer;
+	bool whiteSpace;
+	int precision;
+	int depth; // of the root
+
+	treeWriter(std::string &buffer, bool whiteSpace, int precision, int depth) :
+			buffer(buffer), whiteSpace(whiteSpace), precision(precision), depth(
+					depth) {
+	}
+
+	bool open(const _JS0 *node, size_t level) {
+		if (node->packed) {
+			node->appendPacked(buffer, whiteSpace, precision,
+					depth + (int) level);
+			return false;
+		}
+		buffer.push_back(node->type == OBJECT ? '{' : '[');
+		return true;
+	}
+
+	const _JS0 *member(const _JS0 *node, size_t index, size_t level) {
+		if (index > 0)
+			buffer.push_back(',');
+		if (whiteSpace)
+			INDENT(buffer, depth + (int) level + 1);
+		if (node->type == OBJECT) {
+			const entry *e = node->value.obj->at(index);
 			quoteJsonString(e->key, buffer);
 			buffer.push_back(':');
 			if (whiteSpace)
 				buffer.push_back(' ');
-			e->node->appendJsonString(buffer, whiteSpace, precision, depth + 1);
+			return e->node;
 		}
-		if (whiteSpace)
-			INDENT(buffer, depth);
-		buffer.push_back('}');
+		return node->value.arr->at(index);
 	}
-		break;
-	case _JS0::ARRAY: {
-		buffer.push_back('[');
-		int len = value.arr->size();
-		for (int i = 0; i < len; i++) {
-			if (i > 0)
-				buffer.push_back(',');
-			if (whiteSpace)
-				INDENT(buffer, depth+1);
-			value.arr->at(i)->appendJsonString(buffer, whiteSpace, precision,
-					depth + 1);
-		}
+
+	void close(const _JS0 *node, size_t level) {
 		if (whiteSpace)
-			INDENT(buffer, depth);
-		buffer.push_back(']');
+			INDENT(buffer, depth + (int) level);
+		buffer.push_back(node->type == OBJECT ? '}' : ']');
 	}
-		break;
+
+	void leaf(const _JS0 *node, size_t) {
+		if (node->type == STRING)
+			quoteJsonString(*node->value.str, buffer);
+		else if (node->type != UNDEFINED)
+			node->appendStringValue(buffer, precision);
 	}
+};
+
+void _JS0::appendJsonString(std::string &buffer, bool whiteSpace, int precision,
+		int depth) const {
+	treeWriter writer(buffer, whiteSpace, precision, depth);
+	walk(this, writer);
 }
 
-void _JS0::appendStream(std::ostream &stream) const {
-	if (!stream.good())
-		return;
+/*
+ * Writes the walked tree to stream, stopping when it fails.
+ */
+struct _JS0::streamWriter {
+	std::ostream &stream;
 	std::string buf;
-	switch (type) {
-	case _JS0::STRING: {
-		quoteJsonString(*value.str, buf);
-		stream.write(buf.data(), buf.length());
-		break;
+
+	streamWriter(std::ostream &stream) :
+			stream(stream) {
 	}
-	case _JS0::NUMBER_LONG:
-	case _JS0::NUMBER_DOUBLE:
-	case _JS0::BOOLEAN:
-	case _JS0::NULLVALUE: {
-		appendStringValue(buf, stream.precision());
-		stream.write(buf.data(), buf.length());
-		break;
+
+	bool open(const _JS0 *node, size_t) {
+		if (!stream.good())
+			return false;
+		if (node->packed) {
+			buf.clear();
+			node->appendPacked(buf, false, stream.precision(), 0);
+			stream.write(buf.data(), buf.length());
+			return false;
+		}
+		stream.put(node->type == OBJECT ? '{' : '[');
+		return true;
 	}
-	case _JS0::OBJECT: {
-		stream.put('{');
-		int len = value.obj->size();
-		for (int i = 0; i < len && stream.good(); i++) {
-			struct entry *e = value.obj->at(i);
-			if (i > 0)
-				stream.put(',');
+
+	const _JS0 *member(const _JS0 *node, size_t index, size_t) {
+		if (!stream.good())
+			return 0;
+		if (index > 0)
+			stream.put(',');
+		if (node->type == OBJECT) {
+			const entry *e = node->value.obj->at(index);
 			buf.clear();
 			quoteJsonString(e->key, buf);
 			stream.write(buf.data(), buf.length());
 			stream.put(':');
-			e->node->appendStream(stream);
-		}
-		stream.put('}');
-	}
-		break;
-	case _JS0::ARRAY: {
-		stream.put('[');
-		int len = value.arr->size();
-		for (int i = 0; i < len && stream.good(); i++) {
-			if (i > 0)
-				stream.put(',');
-			value.arr->at(i)->appendStream(stream);
+			return e->node;
 		}
-		stream.put(']');
+		return node->value.arr->at(index);
 	}
-		break;
-	}
-}
 
-void _JS0::quoteJsonString(const std::string &src, std::string &dest) {
-	const char *value = src.c_str();
-	int b = 0, len = src.length();
+	void close(const _JS0 *node, size_t) {
+		stream.put(node->type == OBJECT ? '}' : ']');
+	}
+
+	void leaf(const _JS0 *node, size_t) {
+		if (!stream.good())
+			return;
+		buf.clear();
+		if (node->type == STRING)
+			quoteJsonString(*node->value.str, buf);
+		else if (node->type != UNDEFINED)
+			node->appendStringValue(buf, stream.precision());
+		stream.write(buf.data(), buf.length());
+	}
+};
+
+void _JS0::appendStream(std::ostream &stream) const {
+	streamWriter writer(stream);
+	walk(this, writer);
+}
+
+void _JS0::quoteJsonString(const char *value, size_t length,
+		std::string &dest) {
+	int b = 0, len = length;
 
 	dest.push_back('"');
 
@@ -398,6 +900,13 @@ void _JS0::quoteJsonString(const std::string &src, std::string &dest) {
 			dest.push_back('t');
 			break;
 		default:
+			if ((unsigned char) ch < 0x20) {
+				START_ESCAPE
+				;
+				dest.append("u00");
+				dest.push_back("0123456789abcdef"[(ch >> 4) & 0xf]);
+				dest.push_back("0123456789abcdef"[ch & 0xf]);
+			}
 			break;
 		}
 	}
@@ -414,23 +923,14 @@ void _JS0::toJsonString(std::string &buffer, bool whiteSpace,
 }
 
 void _JS0::appendStringValue(std::string &buffer, int precision) const {
-	if (type == _JS0::NUMBER_LONG) {
-		char buf[32];
-		int len = snprintf(buf, sizeof(buf), "%lld", (long long)value.lng);
-		buffer.append(buf, len);
+	if (aux && (aux->flags & RAW_NUMBER)) {
+		buffer.append(aux->text);
+	} else if (type == _JS0::NUMBER_LONG) {
+		appendLong(buffer, value.lng);
+	} else if (type == _JS0::NUMBER_ULONG) {
+		appendULong(buffer, value.ulng);
 	} else if (type == _JS0::NUMBER_DOUBLE) {
-		char buf[64];
-		int len = snprintf(buf, sizeof(buf), "%.*Lf", precision, value.dbl);
-		if (len > precision + 1) { // get rid of trailing zeros
-			char *p;
-			for (p = buf + len - 1; p > buf && *p == '0'; p--)
-				;
-			if (*p == '.')
-				p--;
-			*(++p) = 0;
-			len = (p - buf);
-		}
-		buffer.append(buf, len);
+		appendDouble(buffer, value.dbl, precision);
 	} else if (type == _JS0::STRING) {
 		buffer.append(*value.str);
 	} else if (type == _JS0::BOOLEAN) {
@@ -440,11 +940,184 @@ void _JS0::appendStringValue(std::string &buffer, int precision) const {
 	}
 }
 
+void _JS0::appendLong(std::string &buffer, int64_t value) {
+	if (value < 0) {
+		buffer.push_back('-');
+		appendULong(buffer, 0 - (uint64_t) value);
+	} else
+		appendULong(buffer, (uint64_t) value);
+}
+
+/*
+ * Writes the digits from the end of buf, snprintf() would cost several
+ * times more in arrays of integers.
+ */
+void _JS0::appendULong(std::string &buffer, uint64_t value) {
+	char buf[24];
+	char *p = buf + sizeof(buf);
+	do {
+		*--p = (char) ('0' + value % 10);
+		value /= 10;
+	} while (value);
+	buffer.append(p, buf + sizeof(buf) - p);
+}
+
+/*
+ * Writes a fixed point number without trailing zeros.  Numbers too long
+ * for that are written with an exponent, and values JSON cannot hold as
+ * null.
+ */
+void _JS0::appendDouble(std::string &buffer, long double value,
+		int precision) {
+	char buf[64];
+	if (value != value || value - value != 0) {
+		buffer.append("null");
+		return;
+	}
+	int len = snprintf(buf, sizeof(buf), "%.*Lf", precision, value);
+	if (len < 0 || len >= (int) sizeof(buf)) {
+		len = snprintf(buf, sizeof(buf), "%.*Lg",
+				(precision < 15) ? 15 : (precision > 18) ? 18 : precision, value);
+		buffer.append(buf, len);
+		return;
+	}
+	if (precision > 0 && len > precision + 1) { // get rid of trailing zeros
+		char *p;
+		for (p = buf + len - 1; p > buf && *p == '0'; p--)
+			;
+		if (*p == '.')
+			p--;
+		*(++p) = 0;
+		len = (p - buf);
+	}
+	buffer.append(buf, len);
+}
+
+/*
+ * Re-encodes the value the reader is about to return, token by token, with
+ * the same rules as appendJsonString().  With no output buffer the input
+ * is only checked.  Nothing but whitespace may follow the value.  The
+ * reader's options apply as in setFromReader(): values are counted
+ * against maxNodes, and numbers read with lazyNumbers keep their text.
+ */
+bool _JS0::transcode(JsonReader &reader, std::string *to, bool whiteSpace,
+		int precision) {
+	size_t nodes = 0;
+	bool first = true;
+	do {
+		JsonReader::Type t = reader.next();
+		int depth = reader.depth();
+		switch (t) {
+		case JsonReader::INVALID:
+		case JsonReader::END:
+			return false;
+		case JsonReader::END_OBJECT:
+		case JsonReader::END_ARRAY:
+			if (to) {
+				if (whiteSpace)
+					INDENT((*to), depth);
+				to->push_back((t == JsonReader::END_OBJECT) ? '}' : ']');
+			}
+			first = false;
+			continue;
+		default:
+			break;
+		}
+		nodes++;
+		if (reader.opts.maxNodes && nodes > reader.opts.maxNodes) {
+			reader.fail(JsonError::TOO_MANY_NODES);
+			return false;
+		}
+		if (to && depth > 0) {
+			if (!first)
+				to->push_back(',');
+			if (whiteSpace)
+				INDENT((*to), depth);
+			if (reader.inObject()) {
+				quoteJsonString(reader.key(), *to);
+				to->push_back(':');
+				if (whiteSpace)
+					to->push_back(' ');
+			}
+		}
+		first = false;
+		switch (t) {
+		case JsonReader::OBJECT:
+		case JsonReader::ARRAY:
+			if (to)
+				to->push_back((t == JsonReader::OBJECT) ? '{' : '[');
+			first = true;
+			break;
+		case JsonReader::NUMBER:
+			if (reader.opts.lazyNumbers) {
+				if (!reader.decodeNumber(false))
+					return false;
+				if (to)
+					to->append(reader.numText, reader.numLength);
+				break;
+			}
+			if (!reader.decodeNumber(true))
+				return false;
+			if (!to)
+				break;
+			switch (reader.numKind) {
+			case JsonReader::NUM_INT64:
+				appendLong(*to, reader.lngValue);
+				break;
+			case JsonReader::NUM_UINT64:
+				appendULong(*to, reader.ulngValue);
+				break;
+			case JsonReader::NUM_DOUBLE:
+				appendDouble(*to, reader.dblValue, precision);
+				break;
+			default: // too large to convert, keep the digits
+				to->append(reader.numText, reader.numLength);
+				break;
+			}
+			break;
+		case JsonReader::STRING:
+			if (to)
+				quoteJsonString(reader.getString(), *to);
+			else if (reader.opts.validateUtf8 || reader.opts.maxStringLength)
+				reader.getString(); // checked when decoded
+			break;
+		case JsonReader::BOOLEAN:
+			if (to)
+				to->append(reader.getBoolean() ? "true" : "false");
+			break;
+		case JsonReader::NULLVALUE:
+			if (to)
+				to->append("null");
+			break;
+		default:
+			break;
+		}
+	} while (reader.depth() > 0 || reader.type() == JsonReader::OBJECT
+			|| reader.type() == JsonReader::ARRAY);
+	if (reader.next() == JsonReader::END)
+		return true;
+	reader.fail(JsonError::TRAILING_DATA);
+	return false;
+}
+
 void _JS0::setLong(int64_t val) {
 	setType(_JS0::NUMBER_LONG);
 	value.lng = val;
 }
 
+/*
+ * Values that fit an int64_t are kept as NUMBER_LONG, so there is only one
+ * type for each integer.
+ */
+void _JS0::setULong(uint64_t val) {
+	if (val <= 0x7FFFFFFFFFFFFFFFULL) {
+		setLong((int64_t) val);
+		return;
+	}
+	setType(_JS0::NUMBER_ULONG);
+	value.ulng = val;
+}
+
 void _JS0::setDouble(long double val) {
 	setType(_JS0::NUMBER_DOUBLE);
 	value.dbl = val;
@@ -467,6 +1140,63 @@ void _JS0::setString(const char *val) {
 	}
 }
 
+/*
+ * Makes the node a number that keeps its text, see struct extra.
+ */
+void _JS0::setRawNumber(const char *text, size_t length, int type) {
+	setType(type);
+	value.dbl = 0;
+	getExtra()->text.assign(text, length);
+	aux->flags = RAW_NUMBER;
+}
+
+void _JS0::decodeRawNumber() const {
+	int64_t lng;
+	uint64_t ulng;
+	long double dbl;
+	JsonReader::convertNumber(aux->text.data(), aux->text.length(), lng, ulng,
+			dbl);
+	if (type == _JS0::NUMBER_DOUBLE)
+		value.dbl = dbl;
+	else if (type == _JS0::NUMBER_ULONG)
+		value.ulng = ulng;
+	else
+		value.lng = lng;
+	aux->flags |= RAW_DECODED;
+}
+
+_JS0::extra *
+_JS0::getExtra() const {
+	if (aux == 0) {
+		aux = new extra;
+		aux->precision = 0;
+		aux->flags = 0;
+		aux->boo = false;
+		aux->lng = 0;
+		aux->ulng = 0;
+		aux->dbl = 0;
+	}
+	return aux;
+}
+
+/*
+ * Returns the number as a string, formatting it only once for a given
+ * precision.
+ */
+const std::string &
+_JS0::numberText(int precision) const {
+	extra *x = getExtra();
+	if ((x->flags & RAW_NUMBER)
+			|| ((x->flags & TEXT_CACHED)
+					&& (type != _JS0::NUMBER_DOUBLE || x->precision == precision)))
+		return x->text;
+	x->text.clear();
+	appendStringValue(x->text, precision);
+	x->precision = precision;
+	x->flags |= TEXT_CACHED;
+	return x->text;
+}
+
 void _JS0::setNull() {
 	setType(_JS0::NULLVALUE);
 }
@@ -483,29 +1213,168 @@ void _JS0::clear() {
 	if (type == _JS0::OBJECT) {
 		for (int i = value.obj->size() - 1; i >= 0; i--) {
 			struct entry *e = value.obj->at(i);
-			e->node->release();
-			delete e;
+			e->node->unlink();
+			freeEntry(e);
 		}
 		value.obj->clear();
+	} else if (packed) {
+		delete value.pack;
+		value.arr = new vector<_JS0 *>();
+		packed = false;
 	} else if (type == _JS0::ARRAY) {
 		for (int i = value.arr->size() - 1; i >= 0; i--) {
-			value.arr->at(i)->release();
+			value.arr->at(i)->unlink();
 		}
 		value.arr->clear();
 	}
 }
 
+/*
+ * Makes this a packed array holding pack, see packedArray.
+ */
+void _JS0::setPacked(packedArray *pack) {
+	if (aux) {
+		delete aux;
+		aux = 0;
+	}
+	reset();
+	type = _JS0::ARRAY;
+	value.pack = pack;
+	packed = true;
+}
+
+/*
+ * Makes a node for each packed number, in blocks when there are many, and
+ * keeps the array as any other from then on.
+ */
+void _JS0::unpack() {
+	const packedArray *p = value.pack;
+	size_t len = p->size();
+	size_t bytes = len * ((sizeof(_JS0) + 15) & ~15);
+	blockCursor cursor(bytes < BULK_MIN ? 0 : bytes);
+	std::vector<_JS0 *> *a = new vector<_JS0 *>(len);
+	for (size_t i = 0; i < len; i++) {
+		_JS0 *n = newNode(cursor);
+		n->type = p->type;
+		if (p->type == _JS0::NUMBER_LONG)
+			n->value.lng = p->lng[i];
+		else
+			n->value.dbl = p->dbl[i];
+		n->link();
+		(*a)[i] = n;
+	}
+	delete p;
+	value.arr = a;
+	packed = false;
+}
+
+/*
+ * Adds the number the reader decoded to this array, which is packed if it
+ * is still empty.  Returns false, leaving the array unpacked, when the
+ * number needs a node of its own.
+ */
+bool _JS0::packNumber(const JsonReader &reader) {
+	int t = (reader.numKind == JsonReader::NUM_INT64) ? _JS0::NUMBER_LONG :
+			(reader.numKind == JsonReader::NUM_DOUBLE) ?
+					_JS0::NUMBER_DOUBLE : _JS0::UNDEFINED;
+	if (!packed) {
+		if (t == _JS0::UNDEFINED || !value.arr->empty())
+			return false;
+		packedArray *p = new packedArray();
+		p->type = t;
+		setPacked(p);
+	} else if (t != value.pack->type) {
+		unpack();
+		return false;
+	}
+	if (t == _JS0::NUMBER_LONG)
+		value.pack->lng.push_back(reader.lngValue);
+	else
+		value.pack->dbl.push_back(reader.dblValue);
+	return true;
+}
+
+/*
+ * Encodes a packed array as appendJsonString() encodes one with nodes,
+ * depth being that of the array.
+ */
+void _JS0::appendPacked(std::string &buffer, bool whiteSpace, int precision,
+		int depth) const {
+	const packedArray *p = value.pack;
+	size_t len = p->size();
+	buffer.push_back('[');
+	for (size_t i = 0; i < len; i++) {
+		if (i > 0)
+			buffer.push_back(',');
+		if (whiteSpace)
+			INDENT(buffer, depth + 1);
+		if (p->type == _JS0::NUMBER_LONG)
+			appendLong(buffer, p->lng[i]);
+		else
+			appendDouble(buffer, p->dbl[i], precision);
+	}
+	if (whiteSpace)
+		INDENT(buffer, depth);
+	buffer.push_back(']');
+}
+
+/*
+ * Copies the first count members of an array as numbers, packed or not.
+ * Returns the number copied, fewer when the array is shorter.
+ */
+size_t _JS0::copyTo(double *to, size_t count) const {
+	size_t len = (type == _JS0::ARRAY) ? (size_t) length() : 0;
+	if (count > len)
+		count = len;
+	if (!packed) {
+		for (size_t i = 0; i < count; i++)
+			to[i] = (double) (*value.arr)[i]->doubleValue();
+	} else {
+		for (size_t i = 0; i < count; i++)
+			to[i] = (double) value.pack->doubleAt(i);
+	}
+	return count;
+}
+
+size_t _JS0::copyTo(int64_t *to, size_t count) const {
+	size_t len = (type == _JS0::ARRAY) ? (size_t) length() : 0;
+	if (count > len)
+		count = len;
+	if (!packed) {
+		for (size_t i = 0; i < count; i++)
+			to[i] = (*value.arr)[i]->longValue();
+	} else {
+		for (size_t i = 0; i < count; i++)
+			to[i] = value.pack->longAt(i);
+	}
+	return count;
+}
+
+void _JS0::assign(const double *from, size_t count) {
+	packedArray *p = new packedArray();
+	p->type = _JS0::NUMBER_DOUBLE;
+	p->dbl.assign(from, from + count);
+	setPacked(p);
+}
+
+void _JS0::assign(const int64_t *from, size_t count) {
+	packedArray *p = new packedArray();
+	p->type = _JS0::NUMBER_LONG;
+	p->lng.assign(from, from + count);
+	setPacked(p);
+}
+
 void _JS0::setByKey(const char *key, _JS0 *val) {
 	setType(_JS0::OBJECT);
 	if (val)
-		val->reserve();
+		val->link();
 	for (int i = value.obj->size() - 1; i >= 0; i--) {
 		struct entry *e = value.obj->at(i);
 		if (e->key.compare(key) == 0) {
-			e->node->release();
+			e->node->unlink();
 			e->node = val;
 			if (val == NULL) {
-				delete e;
+				freeEntry(e);
 				value.obj->erase(value.obj->begin() + i,
 						value.obj->begin() + i + 1);
 			}
@@ -516,6 +1385,7 @@ void _JS0::setByKey(const char *key, _JS0 *val) {
 		struct entry *e = new struct entry;
 		e->node = val;
 		e->key = key;
+		e->hash = JsonKey::hash(e->key.data(), e->key.length());
 		value.obj->push_back(e);
 	}
 }
@@ -523,14 +1393,14 @@ void _JS0::setByKey(const char *key, _JS0 *val) {
 void _JS0::setByKey(const std::string &key, _JS0 *val) {
 	setType(_JS0::OBJECT);
 	if (val)
-		val->reserve();
+		val->link();
 	for (int i = value.obj->size() - 1; i >= 0; i--) {
 		struct entry *e = value.obj->at(i);
 		if (e->key.compare(key) == 0) {
-			e->node->release();
+			e->node->unlink();
 			e->node = val;
 			if (val == NULL) {
-				delete e;
+				freeEntry(e);
 				value.obj->erase(value.obj->begin() + i,
 						value.obj->begin() + i + 1);
 			}
@@ -541,6 +1411,7 @@ void _JS0::setByKey(const std::string &key, _JS0 *val) {
 		struct entry *e = new struct entry;
 		e->node = val;
 		e->key = key;
+		e->hash = JsonKey::hash(e->key.data(), e->key.length());
 		value.obj->push_back(e);
 	}
 }
@@ -548,32 +1419,41 @@ void _JS0::setByKey(const std::string &key, _JS0 *val) {
 void _JS0::setByIndex(int index, _JS0 *val) {
 	if (val && type != _JS0::ARRAY)
 		setType(_JS0::ARRAY);
+	if (packed)
+		unpack();
 	if (val == NULL) {
 		if (index >= 0 && index < (int) value.arr->size()) {
-			value.arr->at(index)->release();
+			value.arr->at(index)->unlink();
 			value.arr->erase(value.arr->begin() + index,
 					value.arr->begin() + index + 1);
 		}
 	} else {
-		val->reserve();
+		val->link();
 		if (index == (int) value.arr->size()) {
 			value.arr->push_back(val);
 		} else if (index >= 0 && index < (int) value.arr->size()) {
 			_JS0 *node = value.arr->at(index);
-			value.arr->assign(index, val);
-			node->release();
+			(*value.arr)[index] = val;
+			node->unlink();
 		} else {
 			// index out of range
 			PRINTERR("setByIndex()", "index out of range");
-			val->release();
+			val->unlink();
 		}
 	}
 
 }
 
 void _JS0::setType(int type) {
-	if (this->type == type)
+	if (aux) {
+		delete aux;
+		aux = 0;
+	}
+	if (this->type == type) {
+		if (packed)
+			unpack();
 		return;
+	}
 	reset();
 	this->type = type;
 	switch (type) {
@@ -590,12 +1470,23 @@ void _JS0::setType(int type) {
 }
 
 void _JS0::erase(int index) {
-	if (type == _JS0::ARRAY) {
+	if (packed) {
+		packedArray *p = value.pack;
+		int len = p->size();
+		if (index == -1)
+			index = len - 1;
+		if (index >= 0 && index < len) {
+			if (p->type == _JS0::NUMBER_LONG)
+				p->lng.erase(p->lng.begin() + index);
+			else
+				p->dbl.erase(p->dbl.begin() + index);
+		}
+	} else if (type == _JS0::ARRAY) {
 		int len = value.arr->size();
 		if (index == -1)
 			index = len - 1;
 		if (index >= 0 && index < len) {
-			value.arr->at(index)->release();
+			value.arr->at(index)->unlink();
 			value.arr->erase(value.arr->begin() + index,
 					value.arr->begin() + index + 1);
 		}
@@ -605,8 +1496,8 @@ void _JS0::erase(int index) {
 			index = len - 1;
 		if (index >= 0 && index < len) {
 			struct entry *e = value.obj->at(index);
-			e->node->release();
-			delete e;
+			e->node->unlink();
+			freeEntry(e);
 			value.obj->erase(value.obj->begin() + index,
 					value.obj->begin() + index + 1);
 		}
@@ -618,8 +1509,8 @@ void _JS0::erase(const char *key) {
 		for (int i = value.obj->size() - 1; i >= 0; i--) {
 			struct entry *e = value.obj->at(i);
 			if (e->key.compare(key) == 0) {
-				e->node->release();
-				delete e;
+				e->node->unlink();
+				freeEntry(e);
 				value.obj->erase(value.obj->begin() + i,
 						value.obj->begin() + i + 1);
 				return;
@@ -633,8 +1524,8 @@ void _JS0::erase(const std::string &key) {
 		for (int i = value.obj->size() - 1; i >= 0; i--) {
 			struct entry *e = value.obj->at(i);
 			if (e->key.compare(key) == 0) {
-				e->node->release();
-				delete e;
+				e->node->unlink();
+				freeEntry(e);
 				value.obj->erase(value.obj->begin() + i,
 						value.obj->begin() + i + 1);
 				return;
@@ -643,691 +1534,188 @@ void _JS0::erase(const std::string &key) {
 	}
 }
 
-bool _JS0::setFromJsonStlString(const std::string &buffer) {
-	const char *p = buffer.c_str();
-	return setFromJsonString(p);
-}
-
-bool _JS0::setFromJsonString(const char *&buffer) {
-	unsigned short s_type;
-	std::string str;
-	bool isComma, isColon, isEnd;
-	if (buffer == 0)
-		return false;
-	if (!fetchNextType(buffer, s_type, isComma, isColon, isEnd) || isComma
-			|| isColon || isEnd) {
-		if (*buffer != 0)
-			PRINTERR("setFromJsonString()", "syntax error: missing value");
-		return false;
-	}
-	switch (s_type) {
-	case _JS0::NUMBER_LONG:
-		if (!parseJsonNumberIntoSelf(buffer)) {
-			PRINTERR("setFromJsonString()", "syntax error: invalid number");
-			return false;
-		}
-		return true;
-	case _JS0::STRING:
-		setType(_JS0::STRING);
-		if (!parseJsonString(buffer, *value.str)) {
-			PRINTERR("setFromJsonString()", "syntax error: invalid string");
-			return false;
-		}
-		return true;
-	case _JS0::NULLVALUE:
-		if (buffer[0] == 'n' && buffer[1] == 'u' && buffer[2] == 'l'
-				&& buffer[3] == 'l') {
-			setType(_JS0::NULLVALUE);
-			buffer += 4;
-		} else {
-			PRINTERR("setFromJsonString()", "syntax error: invalid null value");
-			return false;
-		}
-		return true;
-	case _JS0::BOOLEAN:
-		if (buffer[0] == 't' && buffer[1] == 'r' && buffer[2] == 'u'
-				&& buffer[3] == 'e') {
-			setType(_JS0::BOOLEAN);
-			value.boo = true;
-			buffer += 4;
-		} else if (buffer[0] == 'f' && buffer[1] == 'a' && buffer[2] == 'l'
-				&& buffer[3] == 's' && buffer[4] == 'e') {
-			setType(_JS0::BOOLEAN);
-			value.boo = false;
-			buffer += 5;
-		} else {
-			PRINTERR("setFromJsonString()",
-					"syntax error: invalid boolean value");
-			return false;
-		}
-		return true;
-	case _JS0::OBJECT:
-		setType(_JS0::OBJECT);
-		buffer++;
-		while (1) {
-			if (!fetchNextType(buffer, s_type, isComma, isColon, isEnd)) {
-				PRINTERR("setFromJsonString()",
-						"syntax error: object not closed");
-				return false;
-			}
-			if (isEnd) {
-				if (s_type != _JS0::OBJECT) {
-					PRINTERR("setFromJsonString()",
-							"syntax error: object not closed");
-					return false;
-				}
-				buffer++;
-				return true;
-			}
-			if (s_type != _JS0::STRING) {
-				PRINTERR("setFromJsonString()",
-						"syntax error: object key must be a string");
-				return false;
-			}
-			struct entry *e = new struct entry;
-			if (!parseJsonString(buffer, e->key)) {
-				PRINTERR("setFromJsonString()",
-						"syntax error: invalid string for object key");
-				delete e;
-				return false;
-			}
-			if (!fetchNextType(buffer, s_type, isComma, isColon, isEnd)
-					|| !isColon) {
-				PRINTERR("setFromJsonString()",
-						"syntax error: object colon expected");
-				delete e;
-				return false;
-			}
-			buffer++;
-			e->node = new _JS0();
-			e->node->reserve();
-			if (!e->node->setFromJsonString(buffer)) {
-				e->node->release();
-				delete e;
-				return false;
-			}
-			if (!fetchNextType(buffer, s_type, isComma, isColon, isEnd)
-					|| !(isComma || (isEnd && s_type == _JS0::OBJECT))) {
-				PRINTERR("setFromJsonString()",
-						"syntax error: object comma or end expected");
-				e->node->release();
-				delete e;
-				return false;
-			}
-			buffer++;
-			value.obj->push_back(e);
-			if (isEnd) {
-				return true;
-			}
-		} // while
-		break;
-	case _JS0::ARRAY:
-		setType(_JS0::ARRAY);
-		buffer++;
-		while (1) {
-			if (!fetchNextType(buffer, s_type, isComma, isColon, isEnd)) {
-				PRINTERR("setFromJsonString()",
-						"syntax error: array not closed");
-				return false;
-			}
-			if (isEnd) {
-				if (s_type != _JS0::ARRAY) {
-					PRINTERR("setFromJsonString()",
-							"syntax error: array not closed");
-					return false;
-				}
-				buffer++;
-				return true;
-			}
-			_JS0 *n = new _JS0();
-			n->reserve();
-			if (!n->setFromJsonString(buffer)) {
-				n->release();
-				return false;
-			}
-			if (!fetchNextType(buffer, s_type, isComma, isColon, isEnd)
-					|| !(isComma || (isEnd && s_type == _JS0::ARRAY))) {
-				PRINTERR("setFromJsonString()",
-						"syntax error: array comma or end expected");
-				n->release();
-				return false;
-			}
-			buffer++;
-			value.arr->push_back(n);
-			if (isEnd) {
-				return true;
+void _JS0::erase(const JsonKey &key) {
+	if (type == _JS0::OBJECT) {
+		for (int i = value.obj->size() - 1; i >= 0; i--) {
+			struct entry *e = value.obj->at(i);
+			if (e->hash == key.hashValue() && e->key.length() == key.length()
+					&& e->key.compare(0, key.length(), key.data(),
+							key.length()) == 0) {
+				e->node->unlink();
+				freeEntry(e);
+				value.obj->erase(value.obj->begin() + i,
+						value.obj->begin() + i + 1);
+				return;
 			}
-		} // while
-		break;
-	} // switch
-	return false;
-}
-
-bool _JS0::parseJsonString(const char *&input, std::string &out) {
-	out.clear();
-	if (*input != '"')
-		return false;
-
-	for (int c = *(++input); c != 0; c = *(++input)) {
-		if (c == '"') {
-			input++;
-			return true;
-		}
-		if (c != '\\') {
-			out.push_back(c);
-			continue;
-		}
-		c = *(++input);
-		switch (c) {
-		case 0:
-			return false;
-		case '"':
-			out.push_back('"');
-			break;
-		case '\\':
-			out.push_back('\\');
-			break;
-		case 'n':
-			out.push_back('\n');
-			break;
-		case 't':
-			out.push_back('\t');
-			break;
-		case 'r':
-			out.push_back('\r');
-			break;
-		case 'f':
-			out.push_back('\f');
-			break;
-		case 'b':
-			out.push_back('\b');
-			break;
-		case '/':
-			out.push_back('/');
-			break;
-		case 'u': {
-			short h;
-			unsigned short unicode;
-			c = *(++input);
-			if ((h = HEX(c)) == -1)
-				return false;
-			unicode = h;
-			c = *(++input);
-			if ((h = HEX(c)) == -1)
-				return false;
-			unicode = (unicode << 4) | h;
-			c = *(++input);
-			if ((h = HEX(c)) == -1)
-				return false;
-			unicode = (unicode << 4) | h;
-			c = *(++input);
-			if ((h = HEX(c)) == -1)
-				return false;
-			unicode = (unicode << 4) | h;
-			// XXX: unicode support is not implemented, so
-			// just cheat and reduce character width
-			out.push_back((char) (unicode & 0xff));
-			break;
-		}
-		default:
-			// assume it was not a real escape sequence
-			// as it is outside the JSON specification
-			out.push_back('\\');
-			out.push_back(c);
-			break;
 		}
 	}
-	return false;
 }
 
-bool _JS0::parseJsonString(std::istream &stream, std::string &out) {
-	out.clear();
-	char ch = stream.get();
-	if (ch != '"' || !stream.good())
-		return false;
-
-	for (int c = stream.get(); stream.good(); c = stream.get()) {
-		if (c == '"') {
-			return true;
-		}
-		if (c != '\\') {
-			out.push_back(c);
-			continue;
-		}
-		c = stream.get();
-		if (!stream.good())
-			return false;
-		switch (c) {
-		case '"':
-			out.push_back('"');
-			break;
-		case '\\':
-			out.push_back('\\');
-			break;
-		case 'n':
-			out.push_back('\n');
-			break;
-		case 't':
-			out.push_back('\t');
-			break;
-		case 'r':
-			out.push_back('\r');
+/*
+ * Builds the node from the value the reader is positioned on.  When keep
+ * is not NULL only the matching members are built, the rest is skipped.
+ * Open containers are kept on the reader's frame stack instead of the C
+ * stack, so deeply nested input cannot overflow it.
+ */
+bool _JS0::setFromReader(JsonReader &reader,
+		const JsonProjection::segment *keep) {
+	std::vector<JsonReader::frame> &frames = reader.frames;
+	size_t maxNodes = reader.opts.maxNodes;
+	size_t nodes = 1;
+	_JS0 *node = this;
+	frames.clear();
+	while (1) {
+		bool ok = true;
+		switch (reader.type()) {
+		case JsonReader::NULLVALUE:
+			node->setType(_JS0::NULLVALUE);
 			break;
-		case 'f':
-			out.push_back('\f');
+		case JsonReader::BOOLEAN:
+			node->setBoolean(reader.getBoolean());
 			break;
-		case 'b':
-			out.push_back('\b');
+		case JsonReader::NUMBER:
+			if (reader.opts.lazyNumbers) {
+				ok = reader.decodeNumber(false);
+				if (!ok)
+					break;
+				// short integers always fit, others are checked now
+				int t = reader.dbl ? _JS0::NUMBER_DOUBLE :
+						(reader.numLength < 19) ? _JS0::NUMBER_LONG : -1;
+				if (t < 0) {
+					reader.decodeNumber(true);
+					t = (reader.numKind == JsonReader::NUM_INT64) ?
+							_JS0::NUMBER_LONG :
+						(reader.numKind == JsonReader::NUM_UINT64) ?
+								_JS0::NUMBER_ULONG : _JS0::NUMBER_DOUBLE;
+				}
+				node->setRawNumber(reader.numText, reader.numLength, t);
+				break;
+			}
+			ok = reader.decodeNumber(true);
+			if (!ok)
+				break;
+			switch (reader.numKind) {
+			case JsonReader::NUM_INT64:
+				node->setLong(reader.lngValue);
+				break;
+			case JsonReader::NUM_UINT64:
+				node->setULong(reader.ulngValue);
+				break;
+			case JsonReader::NUM_DOUBLE:
+				node->setDouble(reader.dblValue);
+				break;
+			default: // too large to convert, keep the digits
+				node->setRawNumber(reader.numText, reader.numLength,
+						_JS0::NUMBER_DOUBLE);
+				break;
+			}
 			break;
-		case '/':
-			out.push_back('/');
+		case JsonReader::STRING:
+			node->setType(_JS0::STRING);
+			ok = reader.getString(*node->value.str);
 			break;
-		case 'u': {
-			short h;
-			unsigned short unicode;
-			c = stream.get();
-			if (!stream.good())
-				return false;
-			if ((h = HEX(c)) == -1)
-				return false;
-			unicode = h;
-			c = stream.get();
-			if (!stream.good())
-				return false;
-			if ((h = HEX(c)) == -1)
-				return false;
-			unicode = (unicode << 4) | h;
-			c = stream.get();
-			if (!stream.good())
-				return false;
-			if ((h = HEX(c)) == -1)
-				return false;
-			unicode = (unicode << 4) | h;
-			c = stream.get();
-			if (!stream.good())
-				return false;
-			if ((h = HEX(c)) == -1)
-				return false;
-			unicode = (unicode << 4) | h;
-			// XXX: unicode support is not implemented, so
-			// just cheat and reduce character width
-			out.push_back((char) (unicode & 0xff));
+		case JsonReader::OBJECT:
+		case JsonReader::ARRAY: {
+			JsonReader::frame f;
+			if (reader.type() == JsonReader::OBJECT) {
+				node->setType(_JS0::OBJECT);
+				ok = reader.enterObject();
+			} else {
+				node->setType(_JS0::ARRAY);
+				ok = reader.enterArray();
+			}
+			f.node = node;
+			f.keep = keep;
+			f.index = 0;
+			f.skipped = 0;
+			if (ok)
+				frames.push_back(f);
 			break;
 		}
 		default:
-			// assume it was not a real escape sequence
-			// as it is outside the JSON specification
-			out.push_back('\\');
-			out.push_back(c);
-			break;
-		}
-	}
-	return false;
-}
-
-bool _JS0::parseJsonNumberIntoSelf(const char *&p) {
-	bool isneg = (*p == '-');
-	if (isneg)
-		p++;
-	if (*p < '0' || *p > '9')
-		return false;
-	int64_t ip = *p++ - '0';
-	for (; *p; p++) {
-		char c = *p;
-		if (c < '0' || c > '9')
+			ok = false;
 			break;
-		ip = ip * 10 + (c - '0');
-	}
-	if (*p == '.') {
-		setType(_JS0::NUMBER_DOUBLE);
-		value.dbl = ((long double) ip);
-		ip = 10;
-		p++;
-		for (; *p; p++) {
-			char c = *p;
-			if (c < '0' || c > '9')
-				break;
-			if (c != '0') // save cycles
-				value.dbl += (long double) (c - '0') / (long double) ip;
-			ip *= 10;
 		}
-		if (isneg)
-			value.dbl = -value.dbl;
-	} else {
-		setType(_JS0::NUMBER_LONG);
-		value.lng = ip;
-		if (isneg)
-			value.lng = -value.lng;
-	}
-	return true;
-}
-
-bool _JS0::parseJsonNumberIntoSelf(std::istream &stream) {
-	char ch = stream.get();
-	if (!stream.good())
-		return false;
-	bool isneg = (ch == '-');
-	if (isneg) {
-		ch = stream.get();
-		if (!stream.good())
-			return false;
-	}
-	if (ch < '0' || ch > '9')
-		return false;
-	int64_t ip = ch - '0';
-	ch = stream.get();
-	for (; stream.good(); ch = stream.get()) {
-		if (ch < '0' || ch > '9')
-			break;
-		ip = ip * 10 + (ch - '0');
-	}
-	if (ch == '.') {
-		setType(_JS0::NUMBER_DOUBLE);
-		value.dbl = ((long double) ip);
-		ip = 10;
-		ch = stream.get();
-		for (; stream.good(); ch = stream.get()) {
-			if (ch < '0' || ch > '9')
-				break;
-			if (ch != '0') // save cycles
-				value.dbl += (long double) (ch - '0') / (long double) ip;
-			ip *= 10;
-		}
-		if (isneg)
-			value.dbl = -value.dbl;
-	} else {
-		setType(_JS0::NUMBER_LONG);
-		value.lng = ip;
-		if (isneg)
-			value.lng = -value.lng;
-	}
-	if (stream.good())
-		stream.unget();
-	return true;
-}
-
-bool _JS0::fetchNextType(const char *&buffer, unsigned short &type,
-		bool &isComma, bool &isColon, bool &isEnd) {
-	isColon = isComma = isEnd = false;
-	while (*buffer) {
-		switch (*buffer) {
-		case ' ':
-		case '\t':
-		case '\n':
-		case '\r':
-			buffer++;
-			continue;
-		case '"':
-			type = _JS0::STRING;
-			return true;
-		case '[':
-			type = _JS0::ARRAY;
-			return true;
-		case ']':
-			type = _JS0::ARRAY;
-			isEnd = true;
-			return true;
-		case '{':
-			type = _JS0::OBJECT;
-			return true;
-		case '}':
-			type = _JS0::OBJECT;
-			isEnd = true;
-			return true;
-		case ',':
-			isComma = true;
-			return true;
-		case ':':
-			isColon = true;
-			return true;
-		case '-':
-		case '+':
-		case '0':
-		case '1':
-		case '2':
-		case '3':
-		case '4':
-		case '5':
-		case '6':
-		case '7':
-		case '8':
-		case '9':
-			type = _JS0::NUMBER_LONG;
-			return true;
-		case 'n':
-			type = _JS0::NULLVALUE;
-			return true;
-		case 't':
-		case 'f':
-			type = _JS0::BOOLEAN;
-			return true;
-		default:
+		if (!ok) {
+			// do not keep a value that could not be read
+			if (node != this) {
+				_JS0 *parent = frames.back().node;
+				if (parent->type == _JS0::OBJECT) {
+					freeEntry(parent->value.obj->back());
+					parent->value.obj->pop_back();
+				} else
+					parent->value.arr->pop_back();
+				node->unlink();
+			}
 			return false;
 		}
-	}
-	return false;
-}
 
-bool _JS0::setFromStream(std::istream &stream) {
-	unsigned short s_type;
-	std::string str;
-	bool isComma, isColon, isEnd;
-	if (!fetchNextType(stream, s_type, isComma, isColon, isEnd) || isComma
-			|| isColon || isEnd) {
-		if (!stream.eof())
-			PRINTERR("setFromStream()", "syntax error: missing value");
-		return false;
-	}
-	switch (s_type) {
-	case _JS0::NUMBER_LONG:
-		if (!parseJsonNumberIntoSelf(stream)) {
-			PRINTERR("setFromStream()", "syntax error: invalid number");
-			return false;
-		}
-		return true;
-	case _JS0::STRING:
-		setType(_JS0::STRING);
-		if (!parseJsonString(stream, *value.str)) {
-			PRINTERR("setFromStream()", "syntax error: invalid string");
-			return false;
-		}
-		return true;
-	case _JS0::NULLVALUE:
-		if (stream.get() == 'n' && stream.get() == 'u' && stream.get() == 'l'
-				&& stream.get() == 'l') {
-			setType(_JS0::NULLVALUE);
-		} else {
-			PRINTERR("setFromStream()", "syntax error: invalid null value");
-			return false;
-		}
-		return true;
-	case _JS0::BOOLEAN: {
-		char ch = stream.get();
-		if (ch == 't' && stream.get() == 'r' && stream.get() == 'u'
-				&& stream.get() == 'e') {
-			setType(_JS0::BOOLEAN);
-			value.boo = true;
-		} else if (ch == 'f' && stream.get() == 'a' && stream.get() == 'l'
-				&& stream.get() == 's' && stream.get() == 'e') {
-			setType(_JS0::BOOLEAN);
-			value.boo = false;
-		} else {
-			PRINTERR("setFromStream()", "syntax error: invalid boolean value");
-			return false;
-		}
-		return true;
-	}
-	case _JS0::OBJECT:
-		setType(_JS0::OBJECT);
-		stream.get();
-		while (1) {
-			if (!fetchNextType(stream, s_type, isComma, isColon, isEnd)) {
-				PRINTERR("setFromStream()", "syntax error: object not closed");
-				return false;
-			}
-			if (isEnd) {
-				if (s_type != _JS0::OBJECT) {
-					PRINTERR("setFromStream()",
-							"syntax error: object not closed");
-					return false;
-				}
-				stream.get();
+		// find the next value to build, closing finished containers
+		for (node = 0; node == 0;) {
+			if (frames.empty())
 				return true;
+			JsonReader::frame &f = frames.back();
+			JsonReader::Type t = reader.next();
+			if (t == JsonReader::END_OBJECT || t == JsonReader::END_ARRAY) {
+				frames.pop_back();
+				continue;
 			}
-			if (s_type != _JS0::STRING) {
-				PRINTERR("setFromStream()",
-						"syntax error: object key must be a string");
-				return false;
-			}
-			struct entry *e = new struct entry;
-			if (!parseJsonString(stream, e->key)) {
-				PRINTERR("setFromStream()",
-						"syntax error: invalid string for object key");
-				delete e;
-				return false;
-			}
-			if (!fetchNextType(stream, s_type, isComma, isColon, isEnd)
-					|| !isColon) {
-				PRINTERR("setFromStream()",
-						"syntax error: object colon expected");
-				delete e;
-				return false;
-			}
-			stream.get();
-			e->node = new _JS0();
-			e->node->reserve();
-			if (!e->node->setFromStream(stream)) {
-				e->node->release();
-				delete e;
+			if (t == JsonReader::INVALID)
 				return false;
+			keep = 0;
+			if (f.keep) {
+				const JsonProjection::segment *sub =
+						reader.inObject() ?
+								JsonProjection::match(f.keep, reader.key()) :
+								JsonProjection::match(f.keep, f.index);
+				if (!sub || (!sub->all && t != JsonReader::OBJECT
+						&& t != JsonReader::ARRAY)) {
+					if (!reader.skipValue())
+						return false;
+					if (!reader.inObject()) {
+						f.index++;
+						f.skipped++;
+					}
+					continue;
+				}
+				keep = sub->all ? 0 : sub;
 			}
-			if (!fetchNextType(stream, s_type, isComma, isColon, isEnd)
-					|| !(isComma || (isEnd && s_type == _JS0::OBJECT))) {
-				PRINTERR("setFromStream()",
-						"syntax error: object comma or end expected");
-				e->node->release();
-				delete e;
-				return false;
-			}
-			stream.get();
-			value.obj->push_back(e);
-			if (isEnd) {
-				return true;
-			}
-		} // while
-		break;
-	case _JS0::ARRAY:
-		setType(_JS0::ARRAY);
-		stream.get();
-		while (1) {
-			if (!fetchNextType(stream, s_type, isComma, isColon, isEnd)) {
-				PRINTERR("setFromStream()", "syntax error: array not closed");
+			nodes += 1 + f.skipped;
+			if (maxNodes && nodes > maxNodes) {
+				reader.fail(JsonError::TOO_MANY_NODES);
 				return false;
 			}
-			if (isEnd) {
-				if (s_type != _JS0::ARRAY) {
-					PRINTERR("setFromStream()",
-							"syntax error: array not closed");
+			if (t == JsonReader::NUMBER && reader.opts.packArrays
+					&& !reader.opts.lazyNumbers && !reader.inObject()
+					&& f.skipped == 0) {
+				if (!reader.decodeNumber(true))
 					return false;
+				if (f.node->packNumber(reader)) {
+					f.index++;
+					continue;
 				}
-				stream.get();
-				return true;
-			}
-			_JS0 *n = new _JS0();
-			n->reserve();
-			if (!n->setFromStream(stream)) {
-				n->release();
-				return false;
 			}
-			if (!fetchNextType(stream, s_type, isComma, isColon, isEnd)
-					|| !(isComma || (isEnd && s_type == _JS0::ARRAY))) {
-				PRINTERR("setFromStream()",
-						"syntax error: array comma or end expected");
-				n->release();
-				return false;
-			}
-			stream.get();
-			value.arr->push_back(n);
-			if (isEnd) {
-				return true;
+			node = new _JS0();
+			node->link();
+			if (reader.inObject()) {
+				struct entry *e = new struct entry;
+				e->key = reader.key();
+				e->hash = JsonKey::hash(e->key.data(), e->key.length());
+				e->node = node;
+				f.node->value.obj->push_back(e);
+			} else {
+				if (f.node->packed)
+					f.node->unpack();
+				// keep indexes of the values that are kept
+				for (; f.skipped > 0; f.skipped--) {
+					_JS0 *n = new _JS0();
+					n->link();
+					n->setNull();
+					f.node->value.arr->push_back(n);
+				}
+				f.node->value.arr->push_back(node);
+				f.index++;
 			}
-		} // while
-		break;
-	} // switch
-	return false;
-}
-
-bool _JS0::fetchNextType(std::istream &stream, unsigned short &type,
-		bool &isComma, bool &isColon, bool &isEnd) {
-	isColon = isComma = isEnd = false;
-	while (stream.good()) {
-		char ch = stream.get();
-		if (!stream.good())
-			return false;
-		switch (ch) {
-		case ' ':
-		case '\t':
-		case '\n':
-		case '\r':
-			continue;
-		case '"':
-			type = _JS0::STRING;
-			stream.unget();
-			return true;
-		case '[':
-			type = _JS0::ARRAY;
-			stream.unget();
-			return true;
-		case ']':
-			type = _JS0::ARRAY;
-			stream.unget();
-			isEnd = true;
-			return true;
-		case '{':
-			type = _JS0::OBJECT;
-			stream.unget();
-			return true;
-		case '}':
-			type = _JS0::OBJECT;
-			stream.unget();
-			isEnd = true;
-			return true;
-		case ',':
-			isComma = true;
-			stream.unget();
-			return true;
-		case ':':
-			stream.unget();
-			isColon = true;
-			return true;
-		case '-':
-		case '+':
-		case '0':
-		case '1':
-		case '2':
-		case '3':
-		case '4':
-		case '5':
-		case '6':
-		case '7':
-		case '8':
-		case '9':
-			type = _JS0::NUMBER_LONG;
-			stream.unget();
-			return true;
-		case 'n':
-			type = _JS0::NULLVALUE;
-			stream.unget();
-			return true;
-		case 't':
-		case 'f':
-			type = _JS0::BOOLEAN;
-			stream.unget();
-			return true;
-		default:
-			stream.unget();
-			return false;
 		}
 	}
-	return false;
 }
@@ -30,6 +30,16 @@
 #include <istream>
 #include <ostream>
 #include <stdint.h>
+#include "JsonKey.h"
+#include "JsonReader.h"
+
+// counts references atomically, so nodes can be shared between threads
+#ifdef HAS_JSON_THREADS
+#ifndef JSON_HAS_CXX11
+#error HAS_JSON_THREADS needs C++11
+#endif
+#include <atomic>
+#endif
 
 /*
  * class: _JS0 (private, for use by class JsonHandle only)
@@ -41,6 +51,11 @@
  */
 class _JS0 {
 	friend class JsonHandle;
+	friend class JsonView;
+	friend class JsonPath;
+	friend class JsonBindSupport;
+	friend class JsonFrozen;
+	friend class JsonFrozenView;
 private:
 
 	// list of types
@@ -52,9 +67,10 @@ private:
 	static const unsigned short STRING = 5;
 	static const unsigned short NUMBER_LONG = 6;
 	static const unsigned short NUMBER_DOUBLE = 7;
+	static const unsigned short NUMBER_ULONG = 8; // above INT64_MAX
 
 	_JS0() :
-			type(UNDEFINED), ref_count(0) {
+			type(UNDEFINED), bulk(false), packed(false), links(0), ref_count(0), aux(0) {
 #ifdef HAS_JSON_STATS
 		_JS0::stats.allocs++;
 #endif
@@ -65,11 +81,16 @@ private:
 		_JS0::stats.frees++;
 #endif
 		reset();
+		delete aux;
 	}
 
 	void reset();
 
-	int length() const;
+	int length() const {
+		return type == OBJECT ? (int) value.obj->size() :
+				type != ARRAY ? 0 :
+				packed ? (int) value.pack->size() : (int) value.arr->size();
+	}
 
 	_JS0 *getByIndex(int index) const;
 
@@ -77,10 +98,14 @@ private:
 
 	_JS0 *getByKey(const char *key) const;
 
+	_JS0 *getByKey(const JsonKey &key) const;
+
 	bool booleanValue() const;
 
 	int64_t longValue() const;
 
+	uint64_t ulongValue() const;
+
 	long double doubleValue() const;
 
 	const std::string &stringValue() const;
@@ -95,7 +120,22 @@ private:
 
 	void appendStream(std::ostream &stream) const;
 
-	static void quoteJsonString(const std::string &src, std::string &dest);
+	static void appendLong(std::string &buffer, int64_t value);
+
+	static void appendULong(std::string &buffer, uint64_t value);
+
+	static void appendDouble(std::string &buffer, long double value,
+			int precision);
+
+	static bool transcode(JsonReader &reader, std::string *to,
+			bool whiteSpace, int precision);
+
+	static void quoteJsonString(const std::string &src, std::string &dest) {
+		quoteJsonString(src.data(), src.length(), dest);
+	}
+
+	static void quoteJsonString(const char *value, size_t length,
+			std::string &dest);
 
 	const std::string &getKeyAtIndex(int index) const;
 
@@ -105,8 +145,12 @@ private:
 
 	void erase(const std::string &key);
 
+	void erase(const JsonKey &key);
+
 	void setLong(int64_t value);
 
+	void setULong(uint64_t value);
+
 	void setDouble(long double value);
 
 	void setBoolean(bool value);
@@ -117,6 +161,10 @@ private:
 
 	void setNull();
 
+	void setRawNumber(const char *text, size_t length, int type);
+
+	void decodeRawNumber() const;
+
 	void setObject();
 
 	void setArray();
@@ -131,63 +179,278 @@ private:
 
 	void setType(int type);
 
-	bool setFromJsonStlString(const std::string &from);
+	bool setFromReader(JsonReader &reader,
+			const JsonProjection::segment *keep);
+
+	/*
+	 * The numbers of an array holding only integers or only doubles, kept
+	 * in place of a node each while packed is set.  Reading leaves them
+	 * packed, changes that need the members as nodes call unpack() first.
+	 */
+	struct packedArray {
+		unsigned char type; // NUMBER_LONG or NUMBER_DOUBLE
+		std::vector<int64_t> lng;
+		std::vector<long double> dbl;
+
+		size_t size() const {
+			return type == NUMBER_LONG ? lng.size() : dbl.size();
+		}
+
+		// member i converted as by the getters of a node
+		int64_t longAt(size_t i) const {
+			return type == NUMBER_LONG ? lng[i] : toLong(dbl[i]);
+		}
+
+		uint64_t ulongAt(size_t i) const {
+			return type == NUMBER_LONG ? toULong(lng[i]) : toULong(dbl[i]);
+		}
+
+		long double doubleAt(size_t i) const {
+			return type == NUMBER_LONG ? (long double) lng[i] : dbl[i];
+		}
+
+		static int64_t toLong(long double value) {
+			return JsonReader::clampInt64(value);
+		}
+
+		static uint64_t toULong(int64_t value) {
+			return value < 0 ? 0 : (uint64_t) value;
+		}
+
+		static uint64_t toULong(long double value) {
+			return JsonReader::clampUInt64(value);
+		}
+	};
 
-	bool setFromJsonString(const char *&from);
+	void setPacked(packedArray *pack);
 
-	bool setFromStream(std::istream &from);
+	void unpack();
 
-	static bool parseJsonString(const char *&from, std::string &to);
+	bool packNumber(const JsonReader &reader);
 
-	bool parseJsonNumberIntoSelf(const char *&from);
+	void appendPacked(std::string &buffer, bool whiteSpace, int precision,
+			int depth) const;
 
-	bool parseJsonNumberIntoSelf(std::istream &from);
+	size_t copyTo(double *to, size_t count) const;
 
-	static bool parseJsonString(std::istream &from, std::string &to);
+	size_t copyTo(int64_t *to, size_t count) const;
 
-	static bool fetchNextType(const char *&buffer, unsigned short &type,
-			bool &isComma, bool &isColon, bool &isEnd);
+	void assign(const double *from, size_t count);
 
-	static bool fetchNextType(std::istream &stream, unsigned short &type,
-			bool &isComma, bool &isColon, bool &isEnd);
+	void assign(const int64_t *from, size_t count);
 
 	int getType() {
 		return type;
 	}
 
+	bool isNumber() const {
+		return type == NUMBER_LONG || type == NUMBER_DOUBLE
+				|| type == NUMBER_ULONG;
+	}
+
 	void reserve() {
 #ifdef HAS_JSON_STATS
 		_JS0::stats.reserves++;
 #endif
+#ifdef HAS_JSON_THREADS
+		// taken from a reference already held, so there is nothing to order
+		ref_count.fetch_add(1, std::memory_order_relaxed);
+#else
 		ref_count++;
+#endif
 	}
 
 	void release() {
+		if (releaseLast())
+			destroy();
+	}
+
+	// drops a reference, true when it was the last and the node must go
+	bool releaseLast() {
 #ifdef HAS_JSON_STATS
 		_JS0::stats.releases++;
 #endif
-		if (--ref_count == 0)
-			delete this;
+#ifdef HAS_JSON_THREADS
+		// no other thread can take a new reference from the last one, so
+		// its owner frees the node without a locked decrement
+		return ref_count.load(std::memory_order_acquire) == 1
+				|| ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+#else
+		return --ref_count == 0;
+#endif
+	}
+
+	// a reference from an array or object, counted apart from handles
+	void link() {
+#ifdef HAS_JSON_THREADS
+		unsigned short n = links.load(std::memory_order_relaxed);
+		while (n != LINKS_MAX
+				&& !links.compare_exchange_weak(n, n + 1,
+						std::memory_order_relaxed))
+			;
+#else
+		if (links != LINKS_MAX)
+			links++;
+#endif
+		reserve();
+	}
+
+	void unlink() {
+		if (unlinkLast())
+			destroy();
+	}
+
+	// after a copy on write, the copy must be done before other holders
+	// see the count drop, see own()
+	bool unlinkLast() {
+#ifdef HAS_JSON_THREADS
+		unsigned short n = links.load(std::memory_order_relaxed);
+		while (n != LINKS_MAX
+				&& !links.compare_exchange_weak(n, n - 1,
+						std::memory_order_acq_rel))
+			;
+#else
+		if (links != LINKS_MAX)
+			links--;
+#endif
+		return releaseLast();
 	}
 
+	// links stops here and the node stays shared, copied when changed
+	static const unsigned short LINKS_MAX = 0xffff;
+
+	_JS0 *own(_JS0 *child);
+
 	_JS0 *clone() const;
 
-	void copy(const _JS0 &from);
+	/*
+	 * Walks the tree below root in document order with an explicit stack,
+	 * so depth costs no recursion.  For each node the visitor gets:
+	 *
+	 *   bool open(const _JS0 *node, size_t depth)
+	 *       an array or object, true to walk its members
+	 *   const _JS0 *member(const _JS0 *node, size_t index, size_t depth)
+	 *       before each member of an opened node, returns the member to
+	 *       walk or 0 to skip it
+	 *   void close(const _JS0 *node, size_t depth)
+	 *       after the members of an opened node
+	 *   void leaf(const _JS0 *node, size_t depth)
+	 *       any other value
+	 *
+	 * depth is that of node, 0 for root.
+	 */
+	template<class Visitor>
+	static void walk(const _JS0 *root, Visitor &visitor);
+
+	struct walkFrame {
+		const _JS0 *node;
+		size_t index; // the next member
+		size_t length;
+	};
+
+	struct treeFreer;
+	struct treeCopier;
+	struct treeWriter;
+	struct streamWriter;
+
+	struct block;
+	struct blockCursor;
+
+	static void cloneTree(const _JS0 * const *from, size_t count,
+			_JS0 **to);
+
+	static _JS0 *newNode(blockCursor &cursor);
+
+	static void releaseBlock(void *object);
+
+	void destroy();
+
+	static size_t reclaim(size_t budget);
+
+#ifdef HAS_JSON_THREADS
+	static void startReclaimer();
+
+	static void stopReclaimer();
+
+	static void reclaimLoop();
+#endif
+
+	// arrays and objects released with JsonHandle::deferredFree set
+	static std::vector<_JS0 *> deferred;
+
+	void copy(const _JS0 &from, bool share = false);
+
+	void take(_JS0 &from);
+
+	void detach(const _JS0 *child);
 
 	struct entry {
 		std::string key;
 		_JS0 *node;
+		uint32_t hash; // JsonKey::hash() of key, lets lookups skip compares
+		bool bulk; // allocated in a block by cloneTree()
+
+		entry() :
+				node(0), hash(0), bulk(false) {
+		}
 	};
 
-	mutable unsigned short type;
-	mutable unsigned short ref_count;
+	static void freeEntry(entry *e);
+
+	/*
+	 * Data kept beside the value.  A number read with lazy numbers keeps
+	 * its text, which is written back unchanged and converted into value
+	 * on first use.  Reading a number as a string, or a string as a
+	 * number or boolean, caches the conversion here so the node keeps its
+	 * type.  Any setter drops it.
+	 */
+	struct extra {
+		std::string text; // number text, see RAW_NUMBER and TEXT_CACHED
+		int precision; // of a formatted text
+		unsigned short flags;
+		bool boo;
+		int64_t lng;
+		uint64_t ulng;
+		long double dbl;
+	};
+
+	// extra flags
+	static const unsigned short RAW_NUMBER = 0x01; // text was read from input
+	static const unsigned short RAW_DECODED = 0x02; // value holds text converted
+	static const unsigned short TEXT_CACHED = 0x04; // text holds value formatted
+	static const unsigned short LONG_CACHED = 0x08; // string converted to lng
+	static const unsigned short LONG_VALID = 0x10;
+	static const unsigned short DOUBLE_CACHED = 0x20; // string converted to dbl
+	static const unsigned short DOUBLE_VALID = 0x40;
+	static const unsigned short BOOLEAN_CACHED = 0x80; // string converted to boo
+	static const unsigned short BOOLEAN_VALID = 0x100;
+	static const unsigned short ULONG_CACHED = 0x200; // string converted to ulng
+	static const unsigned short ULONG_VALID = 0x400;
+
+	struct extra *getExtra() const;
+
+	const std::string &numberText(int precision) const;
+
+	mutable unsigned char type;
+	bool bulk :1; // allocated in a block by cloneTree()
+	bool packed :1; // an array holding value.pack, see packedArray
+#ifdef HAS_JSON_THREADS
+	mutable std::atomic<unsigned short> links;
+	mutable std::atomic<uint32_t> ref_count;
+#else
+	mutable unsigned short links; // arrays and objects holding the node
+	mutable uint32_t ref_count; // handles and links holding the node
+#endif
+	mutable struct extra *aux; // fits in the padding before value
 	mutable union {
 		int64_t lng;
+		uint64_t ulng;
 		bool boo;
 		long double dbl;
 		std::vector<_JS0 *> *arr;
 		std::vector<struct entry *> *obj;
 		std::string *str;
+		packedArray *pack;
 	} value;
 
 #ifdef HAS_JSON_STATS
@@ -201,4 +464,39 @@ private:
 
 };
 
+template<class Visitor>
+void _JS0::walk(const _JS0 *root, Visitor &visitor) {
+	if (root->type != OBJECT && root->type != ARRAY) {
+		visitor.leaf(root, 0);
+		return;
+	}
+	if (!visitor.open(root, 0))
+		return;
+	// the innermost open node is kept out of stack, which holds the others
+	std::vector<walkFrame> stack;
+	walkFrame top = { root, 0, (size_t) root->length() };
+	for (;;) {
+		if (top.index == top.length) {
+			visitor.close(top.node, stack.size());
+			if (stack.empty())
+				return;
+			top = stack.back();
+			stack.pop_back();
+			continue;
+		}
+		const _JS0 *node = visitor.member(top.node, top.index++, stack.size());
+		if (!node)
+			continue;
+		if (node->type == OBJECT || node->type == ARRAY) {
+			if (visitor.open(node, stack.size() + 1)) {
+				stack.push_back(top);
+				top.node = node;
+				top.index = 0;
+				top.length = node->length();
+			}
+		} else
+			visitor.leaf(node, stack.size() + 1);
+	}
+}
+
 #endif /* ___JS0_H__ */